@@ -0,0 +1,311 @@
+// ws_bench.cpp
+//
+// WsClient against a loopback server, no network involved.
+//   push: the server sends count messages of size bytes (optionally paced to
+//         rate msg/s and split into fragment byte frames); latency runs from
+//         producing the message to the client handler.
+//   echo: the client sends, the server echoes; latency is the round trip of
+//         the send path, with at most window messages in flight.
+// CPU and allocations are those of the client side: the server thread and
+// the push producer are left out.
+//
+// ws_bench                   run the default suite
+// ws_bench --mode push --size 1024 --count 100000 [--rate 0] [--fragment 0]
+//          [--parse raw|ondemand|dom|arena] [--window 64]
+#include <ws_client.h>
+#include <loopback_server.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <time.h>
+
+using namespace cexpp::util::wss;
+using Clock = std::chrono::steady_clock;
+
+// Allocation counting: every operator new outside excluded threads
+static std::atomic<uint64_t> allocations{0};
+static thread_local bool uncounted = false;
+
+void* operator new(size_t size) {
+    if (!uncounted) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+struct Scenario {
+    std::string name;
+    std::string mode{"push"};
+    size_t size{128};
+    uint64_t count{100000};
+    double rate{0};  // msg/s, 0: as fast as possible
+    size_t fragment{0};
+    ParseMode parse{ParseMode::Raw};
+    size_t window{64};
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static std::chrono::nanoseconds threadCpu() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static std::chrono::nanoseconds processCpu() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+// {"seq":N,"ts":T,"pad":"xxx..."} of exactly size bytes where possible,
+// built in place so the sender allocates nothing once msg has grown
+static void makeMessage(std::string& msg, uint64_t seq, size_t size) {
+    char number[24];
+    msg.assign("{\"seq\":");
+    msg.append(number, std::to_chars(number, number + sizeof(number), seq).ptr);
+    msg.append(",\"ts\":");
+    msg.append(number, std::to_chars(number, number + sizeof(number), nowNs()).ptr);
+    msg.append(",\"pad\":\"");
+    if (msg.size() + 2 < size) {
+        msg.append(size - msg.size() - 2, 'x');
+    }
+    msg.append("\"}");
+}
+
+static int64_t scanTs(std::string_view msg) {
+    const size_t pos = msg.find("\"ts\":");
+    int64_t ts = 0;
+    for (size_t i = pos + 5; pos != std::string_view::npos && i < msg.size() && msg[i] >= '0' && msg[i] <= '9'; ++i) {
+        ts = ts * 10 + (msg[i] - '0');
+    }
+    return ts;
+}
+
+class BenchHandler : public IClientHandler {
+public:
+    explicit BenchHandler(ParseMode mode) : mode_(mode) {}
+
+    void onUpdate() override {}
+    void onMessage(const nlohmann::json& json) override { record(json.value("ts", int64_t(0))); }
+    void onMessage(const std::string& msg) override { record(scanTs(msg)); }
+    bool onRawMessage(std::string_view msg) override {
+        if (mode_ != ParseMode::Raw) {
+            return false;
+        }
+        record(scanTs(msg));
+        return true;
+    }
+    void onDocument(const JsonDoc& doc) override {
+        int64_t ts = 0;
+        doc["ts"].get(ts);
+        record(ts);
+    }
+    void onArenaMessage(const ArenaJson& json) override { record(json["ts"].get<int64_t>()); }
+    ParseMode parseMode() const override { return mode_; }
+    std::string genSubscribePayload(const std::string&, bool) override { return {}; }
+
+    LatencyHistogram latency;
+    std::atomic<uint64_t> received{0};
+
+private:
+    void record(int64_t ts) {
+        latency.record(nowNs() - ts);
+        received.fetch_add(1, std::memory_order_release);
+    }
+
+    ParseMode mode_;
+};
+
+static bool waitFor(const std::function<bool()>& done, std::chrono::milliseconds timeout) {
+    const auto deadline = Clock::now() + timeout;
+    while (!done()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+static void pace(uint64_t i, double rate, Clock::time_point start) {
+    if (rate > 0) {
+        const auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(i) * 1e9 / rate));
+        while (Clock::now() < due) {
+        }
+    }
+}
+
+static void run(const Scenario& s) {
+    testing::LoopbackServerConfig serverConfig;
+    serverConfig.rxBufferBytes = std::max<size_t>(s.size, 4096);
+    serverConfig.onThreadStart = []() { uncounted = true; };
+    testing::LoopbackServer server(serverConfig);
+    std::atomic<uint64_t> session{0};
+    server.onConnect([&session](uint64_t id) { session = id; });
+    if (s.mode == "echo") {
+        server.onMessage([&server](uint64_t id, std::string_view msg) { server.send(id, msg); });
+    }
+
+    BenchHandler handler(s.parse);
+    WsClientConfig config;
+    config.sendRingSlots = 4096;
+    config.sendSlotBytes = s.size + 64;
+    config.multiProducerSend = false;
+    config.loopConfig.rxBufferSize = 16 * 1024;
+    auto client = std::make_shared<WsClient>(&handler, "127.0.0.1", "/", server.port(), false, config);
+    if (!waitFor([&]() { return client->connectionState() == ConnectionState::Connected && session.load(); },
+                 std::chrono::seconds(5))) {
+        std::printf("%-22s connect failed\n", s.name.c_str());
+        return;
+    }
+
+    const auto wallStart = Clock::now();
+    const auto cpuStart = processCpu();
+    const auto serverCpuStart = server.cpuTime();
+    const uint64_t allocStart = allocations.load();
+    std::chrono::nanoseconds producerCpu{0};
+    bool stalled = false;
+
+    if (s.mode == "echo") {
+        // Sent from this thread: the send path is part of the client
+        std::string msg;
+        msg.reserve(s.size + 64);
+        for (uint64_t i = 0; i < s.count; ++i) {
+            pace(i, s.rate, wallStart);
+            // Spin while the window is full, but give up when the echoes stop
+            // (lost connection) instead of hanging the suite
+            if (i - handler.received.load(std::memory_order_acquire) >= s.window) {
+                const auto deadline = Clock::now() + std::chrono::seconds(5);
+                while (i - handler.received.load(std::memory_order_acquire) >= s.window) {
+                    if (Clock::now() > deadline) {
+                        stalled = true;
+                        break;
+                    }
+                }
+                if (stalled) {
+                    break;
+                }
+            }
+            makeMessage(msg, i, s.size);
+            client->send(msg);
+        }
+    } else {
+        std::thread producer([&]() {
+            uncounted = true;
+            const auto cpu = threadCpu();
+            const auto start = Clock::now();
+            std::string msg;
+            for (uint64_t i = 0; i < s.count; ++i) {
+                pace(i, s.rate, start);
+                while (server.queued() >= s.window * 16) {
+                    std::this_thread::yield();
+                }
+                makeMessage(msg, i, s.size);
+                server.send(session, msg, s.fragment);
+            }
+            producerCpu = threadCpu() - cpu;
+        });
+        producer.join();
+    }
+
+    const bool complete = !stalled && waitFor([&]() { return handler.received.load() >= s.count; },
+                                              std::chrono::seconds(30));
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    const uint64_t allocs = allocations.load() - allocStart;
+    const auto cpu = processCpu() - cpuStart - (server.cpuTime() - serverCpuStart) - producerCpu;
+
+    const uint64_t n = handler.received.load();
+    const HistogramSnapshot lat = handler.latency.snapshot();
+    auto us = [](std::chrono::nanoseconds d) { return static_cast<double>(d.count()) / 1000.0; };
+    std::printf("%-22s %8lu %10.0f %8.1f %8.1f %8.1f %8.1f %9.1f %9.1f %8.2f %7.2f%s\n",
+                s.name.c_str(), static_cast<unsigned long>(n),
+                n / elapsed, static_cast<double>(n) * static_cast<double>(s.size) / elapsed / 1e6,
+                us(lat.percentile(50)), us(lat.percentile(90)), us(lat.percentile(99)),
+                us(lat.percentile(99.9)), us(lat.max()),
+                n ? us(cpu) / static_cast<double>(n) : 0.0,
+                n ? static_cast<double>(allocs) / static_cast<double>(n) : 0.0,
+                complete ? "" : "  (incomplete)");
+    client.reset();
+}
+
+static ParseMode parseModeOf(const char* name) {
+    if (!std::strcmp(name, "dom")) {
+        return ParseMode::Dom;
+    }
+    if (!std::strcmp(name, "ondemand")) {
+        return ParseMode::OnDemand;
+    }
+    if (!std::strcmp(name, "arena")) {
+        return ParseMode::Arena;
+    }
+    return ParseMode::Raw;
+}
+
+int main(int argc, char** argv) {
+    std::vector<Scenario> suite;
+    if (argc > 1) {
+        Scenario custom;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const std::string flag = argv[i];
+            const char* value = argv[i + 1];
+            if (flag == "--mode") custom.mode = value;
+            else if (flag == "--size") custom.size = std::strtoull(value, nullptr, 10);
+            else if (flag == "--count") custom.count = std::strtoull(value, nullptr, 10);
+            else if (flag == "--rate") custom.rate = std::strtod(value, nullptr);
+            else if (flag == "--fragment") custom.fragment = std::strtoull(value, nullptr, 10);
+            else if (flag == "--parse") custom.parse = parseModeOf(value);
+            else if (flag == "--window") custom.window = std::strtoull(value, nullptr, 10);
+            else {
+                std::fprintf(stderr, "unknown option %s\n", flag.c_str());
+                return 1;
+            }
+        }
+        custom.name = custom.mode + "-" + std::to_string(custom.size) + "B";
+        suite.push_back(custom);
+    } else {
+        suite = {
+            {"push-128B", "push", 128, 200000},
+            {"push-1KB", "push", 1024, 100000},
+            {"push-1KB-ondemand", "push", 1024, 100000, 0, 0, ParseMode::OnDemand},
+            {"push-1KB-dom", "push", 1024, 100000, 0, 0, ParseMode::Dom},
+            {"push-1KB@20k/s", "push", 1024, 40000, 20000},
+            {"push-64KB-frag4KB", "push", 64 * 1024, 5000, 0, 4096},
+            {"push-1MB", "push", 1024 * 1024, 200},
+            {"echo-128B", "echo", 128, 100000},
+            {"echo-1KB@10k/s", "echo", 1024, 20000, 10000},
+        };
+    }
+
+    std::printf("%-22s %8s %10s %8s %8s %8s %8s %9s %9s %8s %7s\n",
+                "scenario", "msgs", "msg/s", "MB/s", "p50us", "p90us", "p99us", "p99.9us", "maxus",
+                "cpu us/msg", "alloc/msg");
+    for (const auto& scenario : suite) {
+        run(scenario);
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+// decimal.h
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace cexpp::util::wss {
+
+// Decimal text ("27123.45000000", "-0.5", "1e-3" is rejected) as an integer
+// count of 10^-decimals units. Digits beyond decimals must be zeros.
+// No allocation, no locale, no floating point.
+bool parseFixedPoint(std::string_view text, int decimals, int64_t& out);
+
+// Decimal text as the nearest double. Prices and quantities (at most 15
+// significant digits, no exponent) take an exact integer path; anything
+// else goes through std::from_chars. No allocation, no locale.
+bool parseDecimal(std::string_view text, double& out);
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,133 @@
+// dns_cache.h
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+enum class DnsStatus {
+    Resolved,  // addresses returned, possibly stale while a refresh runs
+    Pending,   // first resolution still running
+    Failed     // the last resolution failed and nothing is cached
+};
+
+struct DnsCacheConfig {
+    // getaddrinfo() reports no record TTL, so an entry lives this long. An
+    // expired entry is still served while it is refreshed in the background.
+    std::chrono::seconds ttl{60};
+    // A failed resolution is retried after this long
+    std::chrono::seconds failedTtl{5};
+
+    // Time a TCP connect to every address after each resolution, so the
+    // ranking covers addresses no client has connected to yet
+    bool probe{true};
+    std::chrono::milliseconds probeTimeout{1000};
+
+    // An address whose probe or connection attempt failed goes to the back
+    // of the ranking for this long
+    std::chrono::seconds failurePenalty{30};
+    // Weight of a new sample in the round trip moving averages
+    double rttSmoothing{0.25};
+
+    // Replaces getaddrinfo(), e.g. for a static address list: appends the
+    // addresses of host (numeric, IPv4 or IPv6), false when it cannot
+    std::function<bool(const std::string& host, uint16_t port, std::vector<std::string>& addresses)> resolver;
+};
+
+struct EndpointStats {
+    std::string address;
+    // Smoothed TCP connect time of the probes, 0 before the first
+    std::chrono::nanoseconds connectRtt{0};
+    // Smoothed time from a client's connection attempt to the completed
+    // websocket handshake (TCP, TLS, upgrade), 0 before the first
+    std::chrono::nanoseconds handshakeRtt{0};
+    uint64_t connects{0};  // handshakes completed
+    uint64_t failures{0};  // probes and connection attempts that failed
+};
+
+// Resolved addresses per host and port, shared by the clients connecting
+// there. Lookups never block: resolution and probes run on a thread of the
+// cache. Every address behind a name keeps its round trip times, and
+// lookups rank the addresses fastest first: by probe connect time, or by
+// handshake time where there is no probe yet; unmeasured addresses follow
+// in resolver order, recently failed ones come last.
+class DnsCache {
+public:
+    explicit DnsCache(const DnsCacheConfig& config = DnsCacheConfig());
+    ~DnsCache();
+
+    DnsCache(const DnsCache&) = delete;
+    DnsCache& operator=(const DnsCache&) = delete;
+
+    // Process-wide cache of clients that were not given one
+    static std::shared_ptr<DnsCache> shared();
+
+    // Ranked addresses of host:port. Starts a resolution when the name is
+    // unknown or expired, without waiting for it.
+    DnsStatus lookup(const std::string& host, uint16_t port, std::vector<std::string>& addresses);
+    // Blocking lookup for setup code, waits up to timeout for the first
+    // resolution of an unknown name
+    std::vector<std::string> resolve(const std::string& host, uint16_t port, std::chrono::milliseconds timeout);
+    // Resolve ahead of the first lookup
+    void prefetch(const std::string& host, uint16_t port);
+
+    // Outcomes of connection attempts to an address of host:port
+    void recordHandshake(const std::string& host, uint16_t port, const std::string& address,
+                         std::chrono::nanoseconds rtt);
+    void recordFailure(const std::string& host, uint16_t port, const std::string& address);
+
+    // In ranking order
+    std::vector<EndpointStats> endpointStats(const std::string& host, uint16_t port) const;
+
+private:
+    struct Endpoint {
+        EndpointStats stats;
+        std::chrono::steady_clock::time_point failedAt{};
+    };
+
+    struct Entry {
+        std::string host;
+        uint16_t port{0};
+        std::vector<Endpoint> endpoints;  // resolver order
+        std::chrono::steady_clock::time_point expires{};
+        bool resolving{false};
+        bool failed{false};
+        uint64_t resolutions{0};
+    };
+
+    static std::string key(const std::string& host, uint16_t port);
+    Entry& entry(const std::string& host, uint16_t port);
+    // Queues a resolution unless one is running or the entry is fresh
+    void refresh(Entry& entry, std::chrono::steady_clock::time_point now);
+    std::vector<const Endpoint*> ranked(const Entry& entry, std::chrono::steady_clock::time_point now) const;
+    Endpoint* find(const std::string& host, uint16_t port, const std::string& address);
+    void smooth(std::chrono::nanoseconds& average, std::chrono::nanoseconds sample) const;
+
+    void run();
+    bool resolveHost(const std::string& host, uint16_t port, std::vector<std::string>& addresses) const;
+    void probe(const std::string& name, uint16_t port, const std::vector<std::string>& addresses);
+
+    DnsCacheConfig config_;
+
+    // Entries and the job queue; resolveDone_ wakes blocking resolve() calls
+    mutable std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable resolveDone_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::deque<std::string> jobs_;  // entry keys
+    bool stop_{false};
+    std::thread thread_;
+};
+
+} // namespace cexpp::util::wss
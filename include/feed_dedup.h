@@ -0,0 +1,96 @@
+// feed_dedup.h
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+struct FeedDedupConfig {
+    // Update/trade id fields, tried in order; the first one found identifies
+    // the message (depth and bookTicker "u", trade "t", aggTrade "a"). "t"
+    // goes before "a": a trade's "a" is the seller's order id, shared by
+    // every trade of that order.
+    std::vector<std::string> idFields{"u", "t", "a"};
+    // Mixed into the id, so messages that repeat an id stay distinct (kline
+    // updates all carry the candle's "t"); empty uses the id alone
+    std::string eventTimeField{"E"};
+    // Messages remembered per stream. A copy arriving after this many newer
+    // messages of its stream is taken for a new one.
+    size_t window{64};
+    // Only the first scanBytes of a frame are searched for the fields
+    size_t scanBytes{512};
+};
+
+struct DedupLegStats {
+    uint64_t wins{0};    // first arrivals, delivered from this leg
+    uint64_t losses{0};  // copies another leg had already delivered
+    uint64_t hashed{0};  // messages without an id, identified by content
+    // Share of the updates seen by this leg that it delivered first
+    double winRate() const {
+        return wins + losses ? static_cast<double>(wins) / static_cast<double>(wins + losses) : 0.0;
+    }
+};
+
+// First-arrival filter for redundant connections carrying the same streams.
+// Every leg offers each message with its stream key; only the first copy of
+// an update is let through. Messages are identified by their update/trade id
+// (plus event time), or by a hash of the frame when they carry none, and
+// remembered in a small per-stream sliding window.
+//
+// Thread safe: legs may run on different service threads.
+class FeedDeduplicator {
+public:
+    explicit FeedDeduplicator(size_t legs, const FeedDedupConfig& config = FeedDedupConfig());
+
+    FeedDeduplicator(const FeedDeduplicator&) = delete;
+    FeedDeduplicator& operator=(const FeedDeduplicator&) = delete;
+
+    // True when msg is the first copy of its update; leg < legs()
+    bool firstArrival(size_t leg, std::string_view key, std::string_view msg);
+
+    size_t legs() const { return legCount_; }
+    std::vector<DedupLegStats> stats() const;
+    // Forget every remembered message, e.g. after a resubscribe from scratch
+    void clear();
+
+private:
+    // Last `window` tags of one stream, oldest overwritten first
+    struct Window {
+        std::vector<uint64_t> tags;
+        size_t next{0};
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Window> streams;  // by key hash
+    };
+
+    struct alignas(64) LegCounters {
+        std::atomic<uint64_t> wins{0};
+        std::atomic<uint64_t> losses{0};
+        std::atomic<uint64_t> hashed{0};
+    };
+
+    bool findId(std::string_view head, uint64_t& id) const;
+
+    static constexpr size_t SHARDS = 16;
+
+    FeedDedupConfig config_;
+    std::vector<std::string> idPatterns_;  // "field":
+    std::string eventTimePattern_;
+    size_t legCount_;
+    std::array<Shard, SHARDS> shards_;
+    std::unique_ptr<LegCounters[]> counters_;
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,125 @@
+// frame_capture.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+// Capture file layout, native byte order: a 16 byte FrameFileHeader, then
+// one record per frame, each a FrameRecordHeader followed by the payload,
+// padded to 8 bytes. Records are only ever appended, and the file can be
+// mapped and walked in place.
+struct FrameFileHeader {
+    char magic[8];        // "WSFRAME\0"
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct FrameRecordHeader {
+    int64_t timestampNs;  // receive wall time, ns since the epoch
+    uint32_t connection;  // WsClientConfig::recordConnection of the receiver
+    uint32_t length;      // payload bytes, without the padding
+};
+
+inline constexpr char FRAME_FILE_MAGIC[8] = {'W', 'S', 'F', 'R', 'A', 'M', 'E', '\0'};
+inline constexpr uint32_t FRAME_FILE_VERSION = 1;
+
+struct FrameRecorderConfig {
+    // Each of the two write buffers. The receiving thread only copies into
+    // a buffer; a background thread writes full ones to the file.
+    size_t bufferBytes{1 << 20};
+    // Start a new file instead of appending to an existing capture
+    bool truncate{false};
+};
+
+struct FrameRecorderStats {
+    uint64_t frames{0};
+    uint64_t bytes{0};   // payload bytes
+    uint64_t writes{0};  // buffers written to the file
+    uint64_t stalls{0};  // records that waited for the writer to catch up
+};
+
+// Appends received frames to a capture file, see WsClientConfig::recorder.
+// Safe to share between clients on different threads.
+class FrameRecorder {
+public:
+    explicit FrameRecorder(const std::string& path,
+                           const FrameRecorderConfig& config = FrameRecorderConfig());
+    // Writes out everything recorded
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    void record(uint32_t connection, int64_t timestampNs, std::string_view frame);
+    // Stamped with the current wall time
+    void record(uint32_t connection, std::string_view frame);
+
+    // Wait until everything recorded so far is in the file
+    void flush();
+
+    FrameRecorderStats stats() const;
+
+private:
+    void run();
+    void writeAll(const std::vector<char>& buffer);
+
+    FrameRecorderConfig config_;
+    int fd_{-1};
+
+    // active_ is filled by record(); a full one is swapped with the empty
+    // pending_ and handed to the writer
+    std::mutex mutex_;
+    std::condition_variable writerCv_;
+    std::condition_variable doneCv_;
+    std::vector<char> active_;
+    std::vector<char> pending_;
+    bool writing_{false};
+    bool stopping_{false};
+    std::thread writer_;
+
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> stalls_{0};
+};
+
+struct FrameRecord {
+    int64_t timestampNs{0};
+    uint32_t connection{0};
+    std::string_view data;  // points into the mapping
+};
+
+// Memory-mapped, read-only view of a capture file. A record cut short by a
+// crash of the recorder ends the capture.
+class FrameReader {
+public:
+    // Throws std::runtime_error if the file cannot be mapped or is no capture
+    explicit FrameReader(const std::string& path);
+    ~FrameReader();
+
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    // Next record, false at the end of the capture
+    bool next(FrameRecord& record);
+    void rewind();
+
+    size_t size() const { return size_; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    size_t offset_{0};
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,65 @@
+// frame_replay.h
+
+#pragma once
+
+#include "frame_capture.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace cexpp::util::wss {
+
+class WsClient;
+
+enum class ReplayPace {
+    AsFastAsPossible,  // back to back, for benchmarks and backtests
+    Recorded           // at the captured inter-arrival times, scaled by speed
+};
+
+struct ReplayConfig {
+    ReplayPace pace{ReplayPace::AsFastAsPossible};
+    // Recorded pace only: 2.0 replays twice as fast as captured
+    double speed{1.0};
+    // Only frames of this recorded connection; -1 replays all of them
+    int64_t connection{-1};
+    // Stop after this many frames, 0 for the whole capture
+    uint64_t maxFrames{0};
+};
+
+struct ReplayStats {
+    uint64_t frames{0};
+    uint64_t bytes{0};
+    std::chrono::nanoseconds elapsed{0};
+    // Recorded pace: how far delivery fell behind the schedule at worst
+    std::chrono::nanoseconds maxLateness{0};
+
+    double framesPerSecond() const {
+        return elapsed.count() ? static_cast<double>(frames) * 1e9 / static_cast<double>(elapsed.count()) : 0.0;
+    }
+};
+
+// Feeds a capture file back through the receive path, without a network.
+class FrameReplayer {
+public:
+    explicit FrameReplayer(const std::string& path);
+
+    // Through client.processMessage() on the client's service thread, so
+    // routing, parse modes, the rx pipeline and metrics behave as live. The
+    // client should be offline (WsClientConfig::autoConnect = false) and its
+    // loop is busy until the replay ends; routes added before run() apply.
+    ReplayStats run(WsClient& client, const ReplayConfig& config = ReplayConfig());
+    // To any sink, on the calling thread
+    ReplayStats run(const std::function<void(const FrameRecord&)>& sink,
+                    const ReplayConfig& config = ReplayConfig());
+
+    // Ends a running replay after the current frame; any thread
+    void stop() { stopped_ = true; }
+
+private:
+    FrameReader reader_;
+    std::atomic<bool> stopped_{false};
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,132 @@
+// json_scanner.h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+// How a handler wants its messages delivered
+enum class ParseMode {
+    Dom,       // nlohmann::json DOM, IClientHandler::onMessage(const nlohmann::json&)
+    OnDemand,  // structural index over the raw frame, IClientHandler::onDocument()
+    Raw,       // the frame as is, IClientHandler::onRawMessage()
+    Arena      // nlohmann DOM built in a per-message arena, IClientHandler::onArenaMessage()
+};
+
+class JsonDoc;
+
+// Lazily decoded value inside a JsonDoc. Cheap to copy, only valid as long
+// as the document (and the frame it indexes) is.
+class JsonValue {
+public:
+    enum class Type { Invalid, Object, Array, String, Number, True, False, Null };
+
+    JsonValue() = default;
+
+    Type type() const { return type_; }
+    bool valid() const { return type_ != Type::Invalid; }
+    bool isObject() const { return type_ == Type::Object; }
+    bool isArray() const { return type_ == Type::Array; }
+    bool isString() const { return type_ == Type::String; }
+    bool isNumber() const { return type_ == Type::Number; }
+    bool isNull() const { return type_ == Type::Null; }
+    explicit operator bool() const { return valid(); }
+
+    // Object member lookup, Invalid when missing or not an object
+    JsonValue operator[](std::string_view key) const;
+    // Array element by position (linear walk), Invalid when out of range
+    JsonValue at(size_t index) const;
+
+    // Raw text: string contents without quotes (escapes untouched), or the
+    // literal text of numbers/true/false/null/objects/arrays
+    std::string_view raw() const { return text_; }
+
+    // Typed reads. Numbers may also be given as quoted strings, as most
+    // exchanges send prices. Return false on type or format mismatch.
+    bool get(std::string_view& out) const;  // strings without escapes only
+    bool get(std::string& out) const;       // unescapes
+    bool get(int64_t& out) const;
+    bool get(uint64_t& out) const;
+    bool get(double& out) const;
+    bool get(bool& out) const;
+
+    template <typename Fn>
+    void forEachField(Fn&& fn) const;   // fn(std::string_view key, JsonValue value)
+    template <typename Fn>
+    void forEachElement(Fn&& fn) const; // fn(JsonValue value)
+
+private:
+    friend class JsonDoc;
+
+    JsonValue first() const;
+    JsonValue next() const;
+    std::string_view key() const { return key_; }
+    bool getNumberText(std::string_view& out) const;
+
+    const JsonDoc* doc_{nullptr};
+    Type type_{Type::Invalid};
+    uint32_t tok_{0};    // structural token the value starts at, or its terminator for scalars
+    uint32_t after_{0};  // first structural token after the value
+    std::string_view text_;
+    std::string_view key_;  // member name when reached through an object walk
+    bool member_{false};    // reached through an object walk (next() reads a key)
+};
+
+// Structural index over a JSON text (simdjson style stage 1): the positions
+// of {}[]:, and of every opening quote outside strings, found 64 bytes at a
+// time with AVX2/SSE4.2 kernels picked at runtime. Values are then decoded on
+// demand straight from the original buffer; nothing is copied or allocated
+// once the index vectors have grown to the largest message seen.
+class JsonDoc {
+public:
+    // Index json, which must outlive every JsonValue handed out.
+    // Returns false when json is not an object or array, on unbalanced
+    // brackets or an unterminated string.
+    bool parse(std::string_view json);
+
+    JsonValue root() const;
+    JsonValue operator[](std::string_view key) const { return root()[key]; }
+    std::string_view text() const { return text_; }
+
+    // Kernel used for stage 1: "avx2", "sse4.2" or "scalar"
+    static const char* backend();
+
+private:
+    friend class JsonValue;
+
+    JsonValue valueAfter(uint32_t tok) const { return valueFrom(tok + 1, index_[tok] + 1); }
+    JsonValue valueFrom(uint32_t tok, size_t scalarBegin) const;
+    JsonValue member(uint32_t tok) const;
+    char at(uint32_t tok) const { return text_[index_[tok]]; }
+
+    std::string_view text_;
+    std::vector<uint32_t> index_;  // byte offsets of structural characters
+    std::vector<uint32_t> match_;  // for { and [: token index of the matching close
+    std::vector<uint32_t> stack_;
+};
+
+template <typename Fn>
+void JsonValue::forEachField(Fn&& fn) const {
+    if (type_ != Type::Object) {
+        return;
+    }
+    for (JsonValue v = first(); v.valid(); v = v.next()) {
+        fn(v.key(), v);
+    }
+}
+
+template <typename Fn>
+void JsonValue::forEachElement(Fn&& fn) const {
+    if (type_ != Type::Array) {
+        return;
+    }
+    for (JsonValue v = first(); v.valid(); v = v.next()) {
+        fn(v);
+    }
+}
+
+} // namespace cexpp::util::wss
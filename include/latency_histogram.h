@@ -0,0 +1,67 @@
+// latency_histogram.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+// Copy of a LatencyHistogram taken at one point in time
+class HistogramSnapshot {
+public:
+    uint64_t count() const { return count_; }
+    std::chrono::nanoseconds min() const { return std::chrono::nanoseconds(min_); }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(max_); }
+    std::chrono::nanoseconds mean() const;
+    // Value at percentile p (0..100), to within the bucket precision
+    std::chrono::nanoseconds percentile(double p) const;
+
+private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_{0};
+    uint64_t sum_{0};
+    uint64_t min_{0};
+    uint64_t max_{0};
+};
+
+// HDR-style histogram of nanosecond durations: exact below 128 ns, then 64
+// linear sub-buckets per power of two (under 1.6% relative error) up to
+// about an hour, larger values land in the last bucket. Recording is a few
+// relaxed atomic adds and never allocates; snapshot() may run on any thread
+// while the owner keeps recording.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(int64_t ns);
+    void record(std::chrono::nanoseconds d) { record(d.count()); }
+
+    HistogramSnapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t ns);
+    static uint64_t bucketValue(size_t index);  // lower bound of the bucket
+
+    static constexpr int SUB_BUCKET_BITS = 7;
+    static constexpr int MAX_VALUE_BITS = 42;  // 2^42 ns, about 73 minutes
+    static constexpr size_t BUCKETS =
+        (size_t{1} << SUB_BUCKET_BITS) + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * (size_t{1} << (SUB_BUCKET_BITS - 1));
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,155 @@
+// msg_arena.h
+
+#pragma once
+
+#include "json_scanner.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+namespace detail {
+// Arena of the dispatch running on this thread, nullptr outside of one
+inline std::pmr::memory_resource*& currentArenaResource() {
+    thread_local std::pmr::memory_resource* resource = nullptr;
+    return resource;
+}
+} // namespace detail
+
+// Allocator that picks its memory resource when it is constructed: the
+// arena of the running dispatch, the heap otherwise. nlohmann::basic_json
+// default-constructs its allocators, so this is how a DOM ends up in the
+// arena without threading a resource through the parser.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() noexcept
+        : resource(detail::currentArenaResource() ? detail::currentArenaResource()
+                                                  : std::pmr::new_delete_resource()) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : resource(other.resource) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return resource == other.resource; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return resource != other.resource; }
+
+    std::pmr::memory_resource* resource;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// nlohmann DOM whose nodes, containers and strings all live in the arena.
+// Read strings with get_ref<const ArenaString&>() (or as string_view).
+// Only valid inside IClientHandler::onArenaMessage(): copy out what has to be
+// kept, never the ArenaJson itself.
+using ArenaJson = nlohmann::basic_json<std::map, std::vector, ArenaString,
+                                       bool, std::int64_t, std::uint64_t, double,
+                                       ArenaAllocator>;
+
+struct MessageArenaStats {
+    uint64_t messages{0};         // resets, one per dispatch
+    uint64_t allocations{0};      // served by the arena
+    uint64_t bytes{0};
+    uint64_t heapAllocations{0};  // arena overflows that went to the heap
+    size_t capacity{0};           // current preallocated block
+    size_t peakBytes{0};          // largest single message footprint
+};
+
+// Monotonic arena for everything decoded from one message. Allocation is a
+// pointer bump, deallocation a no-op, and reset() after the dispatch frees it
+// all at once. When a message overflows the block the next reset() grows it,
+// so in steady state the heap is never touched.
+// Single threaded: one per connection or consumer thread.
+class MessageArena {
+public:
+    explicit MessageArena(size_t initialBytes = 64 * 1024);
+
+    MessageArena(const MessageArena&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+
+    std::pmr::memory_resource* resource();
+    void reset();
+    MessageArenaStats stats() const;
+
+    // Arena of the dispatch running on this thread, nullptr outside of one.
+    // Handlers can put their own decoded structures here (std::pmr containers).
+    static MessageArena* current();
+
+private:
+    // Counts what passes through to upstream. Without an upstream yet, the
+    // first allocation builds owner's block.
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        std::pmr::memory_resource* upstream{nullptr};
+        MessageArena* owner{nullptr};
+        uint64_t allocations{0};
+        uint64_t bytes{0};
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    void rebuild(size_t capacity);
+
+    std::unique_ptr<std::byte[]> block_;
+    size_t capacity_{0};
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+    CountingResource front_;  // what callers allocate through
+    CountingResource heap_;   // upstream of monotonic_
+
+    // Published copies of the counters, read from other threads
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> heapAllocations_{0};
+    std::atomic<size_t> publishedCapacity_{0};
+    std::atomic<size_t> peakBytes_{0};
+
+    friend class ArenaScope;
+};
+
+// Makes arena the current arena of this thread; on exit restores the
+// previous one and resets arena. Values allocated in the scope must be
+// destroyed before it ends.
+class ArenaScope {
+public:
+    explicit ArenaScope(MessageArena& arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    MessageArena& arena_;
+    std::pmr::memory_resource* previous_;
+    MessageArena* previousArena_;
+};
+
+// DOM of an indexed document, built in the current arena and released by
+// its reset (the root is never destroyed). Together with JsonDoc, whose
+// index storage is reused, nothing touches the heap, which nlohmann's own
+// parser cannot offer. Throws outside of an ArenaScope.
+const ArenaJson& buildArenaJson(const JsonValue& value);
+
+} // namespace cexpp::util::wss
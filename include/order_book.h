@@ -0,0 +1,249 @@
+// order_book.h
+
+#pragma once
+
+#include "websocket_client_base.h"
+#include "json_scanner.h"
+#include "decimal.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+enum class BookSide { Bid, Ask };
+
+struct PriceLevel {
+    int64_t price{0};     // fixed point, OrderBookConfig::priceDecimals
+    int64_t quantity{0};  // fixed point, OrderBookConfig::quantityDecimals
+};
+
+// Price levels of one side in a contiguous array, sorted so that the best
+// level is the last element: top-of-book is back(), and the updates that
+// hit near the top (most of them) move only the few elements behind them.
+class BookLadder {
+public:
+    explicit BookLadder(BookSide side) : side_(side) {}
+
+    // quantity 0 removes the level. Keeps at most maxLevels, dropping the
+    // worst. False when asked to remove a level that is not there.
+    bool apply(int64_t price, int64_t quantity, size_t maxLevels);
+    void clear() { levels_.clear(); }
+
+    bool empty() const { return levels_.empty(); }
+    size_t size() const { return levels_.size(); }
+    // depth 0 is the best level; depth < size()
+    PriceLevel level(size_t depth) const {
+        const Level& l = levels_[levels_.size() - 1 - depth];
+        return {priceOf(l.key), l.quantity};
+    }
+    PriceLevel best() const { return empty() ? PriceLevel() : level(0); }
+    // Quantity resting at price, 0 when there is no such level
+    int64_t quantityAt(int64_t price) const;
+
+private:
+    // Asks are stored by negated price, so both sides keep ascending keys
+    // with the best level last
+    struct Level {
+        int64_t key;
+        int64_t quantity;
+    };
+
+    int64_t keyOf(int64_t price) const { return side_ == BookSide::Bid ? price : -price; }
+    int64_t priceOf(int64_t key) const { return side_ == BookSide::Bid ? key : -key; }
+    std::vector<Level>::iterator find(int64_t key);
+
+    BookSide side_;
+    std::vector<Level> levels_;
+};
+
+// REST depth snapshot, e.g. GET /api/v3/depth
+struct DepthSnapshot {
+    uint64_t lastUpdateId{0};
+    std::vector<PriceLevel> bids;
+    std::vector<PriceLevel> asks;
+};
+
+// Where snapshots come from. fetch() may answer synchronously or later from
+// any thread, but must call done exactly once per call, and not after the
+// book is gone.
+class ISnapshotSource {
+public:
+    using DoneFn = std::function<void(bool ok, DepthSnapshot&& snapshot)>;
+
+    virtual ~ISnapshotSource() = default;
+    virtual void fetch(const std::string& symbol, int priceDecimals, int quantityDecimals, DoneFn done) = 0;
+};
+
+// Reads Binance REST depth JSON ({"lastUpdateId":N,"bids":[["p","q"],...],
+// "asks":[...]}) from a file. Every "{symbol}" in the path is replaced by
+// the symbol. Answers synchronously.
+class FileSnapshotSource : public ISnapshotSource {
+public:
+    explicit FileSnapshotSource(std::string path) : path_(std::move(path)) {}
+
+    void fetch(const std::string& symbol, int priceDecimals, int quantityDecimals, DoneFn done) override;
+
+    static bool parse(std::string_view json, int priceDecimals, int quantityDecimals, DepthSnapshot& out);
+
+private:
+    std::string path_;
+};
+
+struct OrderBookConfig {
+    std::string symbol;
+    int priceDecimals{8};
+    int quantityDecimals{8};
+    // Levels kept per side; the snapshot's depth is usually enough
+    size_t maxLevels{5000};
+    // Diffs held while a snapshot is on its way; the oldest go first
+    size_t maxBufferedDiffs{10000};
+    // Wait before asking again after a snapshot could not be fetched, or was
+    // too old to bridge the buffered diffs
+    std::chrono::milliseconds snapshotRetry{1000};
+};
+
+enum class BookState {
+    Syncing,  // waiting for a snapshot, diffs are buffered
+    Live      // snapshot plus every diff since, in sequence
+};
+
+struct OrderBookStats {
+    uint64_t diffs{0};      // diffs applied to a live book
+    uint64_t levels{0};     // price level changes applied
+    uint64_t buffered{0};   // diffs held during a sync
+    uint64_t stale{0};      // diffs already covered by the book, skipped
+    uint64_t gaps{0};       // sequence breaks that forced a resync
+    uint64_t snapshots{0};  // snapshots requested
+    uint64_t rejected{0};   // malformed messages
+};
+
+// Top-of-book as one consistent copy
+struct TopOfBook {
+    PriceLevel bid;
+    PriceLevel ask;
+    uint64_t updateId{0};
+};
+
+// L2 book of one symbol kept from a Binance @depth diff stream:
+//   - diffs arriving before the book is live are buffered, and a snapshot
+//     is requested from the ISnapshotSource;
+//   - the snapshot is loaded, buffered diffs it already covers (u <=
+//     lastUpdateId) are dropped, the first one left must straddle
+//     lastUpdateId + 1, and the rest are replayed;
+//   - live diffs must follow on: U == previous u + 1, or pu == previous u
+//     on futures streams. A break resyncs from a new snapshot.
+//
+// Register it as the route handler of the depth channel:
+//     client->addRoute("btcusdt@depth@100ms", &book);
+// It takes the OnDemand index, so no DOM is built. The book itself is
+// owned by the thread feeding it; top() can be read from any thread.
+class OrderBookSync : public IClientHandler {
+public:
+    using UpdateFn = std::function<void(const OrderBookSync& book)>;
+
+    OrderBookSync(const OrderBookConfig& config, std::shared_ptr<ISnapshotSource> source);
+
+    // Called on the feeding thread after every change to the live book
+    void setUpdateCallback(UpdateFn fn) { updateFn_ = std::move(fn); }
+
+    // Feed one depth message (plain or wrapped in a combined-stream
+    // envelope) without a client, e.g. from a replay. False if malformed.
+    bool onDepthMessage(std::string_view msg);
+
+    // Hand in a snapshot, any thread; used by sources that answer later
+    void onSnapshot(bool ok, DepthSnapshot&& snapshot);
+
+    BookState state() const { return state_.load(std::memory_order_acquire); }
+    uint64_t lastUpdateId() const { return lastUpdateId_; }
+    const BookLadder& bids() const { return bids_; }
+    const BookLadder& asks() const { return asks_; }
+    const BookLadder& ladder(BookSide side) const { return side == BookSide::Bid ? bids_ : asks_; }
+
+    // Seqlock read, wait-free for the writer; any thread
+    TopOfBook top() const;
+    OrderBookStats stats() const;
+
+    double price(int64_t fixed) const { return static_cast<double>(fixed) / priceScale_; }
+    double quantity(int64_t fixed) const { return static_cast<double>(fixed) / quantityScale_; }
+
+    // IClientHandler
+    ParseMode parseMode() const override { return ParseMode::OnDemand; }
+    void onDocument(const JsonDoc& doc) override;
+    void onUpdate() override {}
+    void onMessage(const nlohmann::json&) override {}
+    void onMessage(const std::string& msg) override { onDepthMessage(msg); }
+    std::string genSubscribePayload(const std::string&, bool) override { return {}; }
+
+private:
+    struct Diff {
+        uint64_t first{0};     // U
+        uint64_t last{0};      // u
+        uint64_t previous{0};  // pu, futures only
+        bool hasPrevious{false};
+        std::vector<PriceLevel> bids;
+        std::vector<PriceLevel> asks;
+    };
+
+    bool decode(JsonValue data, Diff& diff) const;
+    void onDiff(Diff& diff);
+    void live(Diff& diff);
+    void apply(const Diff& diff);
+    void buffer(Diff& diff);
+    void requestSnapshot();
+    void takeSnapshot();
+    void loadSnapshot(DepthSnapshot& snapshot);
+    void resync();
+    void publishTop();
+
+    OrderBookConfig config_;
+    std::shared_ptr<ISnapshotSource> source_;
+    UpdateFn updateFn_;
+    double priceScale_;
+    double quantityScale_;
+
+    // Feeding thread
+    BookLadder bids_{BookSide::Bid};
+    BookLadder asks_{BookSide::Ask};
+    std::atomic<BookState> state_{BookState::Syncing};
+    uint64_t lastUpdateId_{0};
+    bool awaitingFirst_{false};  // loaded a snapshot, no diff applied yet
+    Diff scratch_;
+    std::vector<Diff> buffered_;  // oldest first
+    std::vector<Diff> spare_;     // recycled, keeps their level capacity
+    bool snapshotPending_{false};
+    std::chrono::steady_clock::time_point nextSnapshot_{};
+    JsonDoc doc_;
+
+    // Snapshot hand-over from the source
+    std::mutex snapshotMutex_;
+    std::atomic<bool> snapshotReady_{false};
+    bool snapshotOk_{false};
+    DepthSnapshot snapshot_;
+
+    // Top-of-book seqlock: odd while being written
+    std::atomic<uint64_t> topSeq_{0};
+    std::atomic<int64_t> topBidPrice_{0};
+    std::atomic<int64_t> topBidQuantity_{0};
+    std::atomic<int64_t> topAskPrice_{0};
+    std::atomic<int64_t> topAskQuantity_{0};
+    std::atomic<uint64_t> topUpdateId_{0};
+
+    struct Counters {
+        std::atomic<uint64_t> diffs{0};
+        std::atomic<uint64_t> levels{0};
+        std::atomic<uint64_t> buffered{0};
+        std::atomic<uint64_t> stale{0};
+        std::atomic<uint64_t> gaps{0};
+        std::atomic<uint64_t> snapshots{0};
+        std::atomic<uint64_t> rejected{0};
+    } counters_;
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,98 @@
+// redundant_client.h
+
+#pragma once
+
+#include "ws_client.h"
+#include "feed_dedup.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+struct RedundantClientConfig {
+    // Physical connections carrying the same subscriptions
+    size_t legs{2};
+    // Template for every leg; dedup, dedupLeg and addressOffset are set per
+    // leg. Without a loop all legs share one private loop.
+    WsClientConfig leg;
+    // Leg i runs on loops[i % loops.size()] when set. Legs on different
+    // loops deliver from different threads: the handler must be thread safe.
+    std::vector<std::shared_ptr<WsEventLoop>> loops;
+    // Connect the legs to different addresses when the host resolves to
+    // several, so one bad route or server does not take out every leg
+    bool spreadAddresses{true};
+    FeedDedupConfig dedup;
+};
+
+struct RedundantLegStats {
+    std::string address;  // of the leg's connection, empty before the first
+    ConnectionState state{ConnectionState::Connecting};
+    DedupLegStats dedup;
+};
+
+// One logical feed over several hot-standby connections. Subscriptions go
+// to every leg, and each update reaches the handler once, from whichever
+// leg received it first. A leg dropping out is invisible as long as one
+// other leg is up; the faster route wins every race, which cuts the tail.
+class RedundantWsClient : public ClientBase {
+public:
+    RedundantWsClient(IClientHandler* handler,
+                      std::string_view url,
+                      std::string_view path,
+                      uint16_t port = 443,
+                      bool useSSL = true,
+                      const RedundantClientConfig& config = RedundantClientConfig());
+
+    // Reconnects every leg
+    void reconnect(std::string_view reason) override;
+    // Sent once, on the first connected leg
+    void send(std::string_view payload) const override;
+
+    void subscribe(std::string_view name,
+                   std::string_view payload,
+                   std::string_view successKey,
+                   bool waitOk) override;
+
+    void unSubscribe(std::string_view name,
+                     std::string_view payload,
+                     std::string_view successKey,
+                     bool waitOk) override;
+
+    void subscribeDynamic(std::string_view name,
+                          std::string_view successKey,
+                          bool waitOk) override;
+
+    void unSubscribeDynamic(std::string_view name,
+                            std::string_view successKey,
+                            bool waitOk) override;
+
+    void subscribeMany(const std::vector<std::string>& names,
+                       std::string_view successKey,
+                       bool waitOk) override;
+
+    void unSubscribeMany(const std::vector<std::string>& names,
+                         std::string_view successKey,
+                         bool waitOk) override;
+
+    // Ok once any leg has it; unsubscribed once every leg has dropped it
+    bool isSubscribeOk(std::string_view name) override;
+    bool isUnsubscribeOk(std::string_view name) override;
+
+    void addRoute(std::string_view channel, IClientHandler* channelHandler);
+    void removeRoute(std::string_view channel);
+
+    // Connected legs
+    size_t legsUp() const;
+    size_t legs() const { return legs_.size(); }
+    WsClient& leg(size_t index) { return *legs_.at(index); }
+
+    std::vector<RedundantLegStats> legStats() const;
+
+private:
+    std::shared_ptr<FeedDeduplicator> dedup_;
+    std::vector<std::shared_ptr<WsClient>> legs_;
+};
+
+} // namespace cexpp::util::wss
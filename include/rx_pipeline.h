@@ -0,0 +1,160 @@
+// rx_pipeline.h
+
+#pragma once
+
+#include "json_scanner.h"
+#include "msg_arena.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+class IClientHandler;
+class WsClient;
+
+// What the service thread does when a consumer's ring is full
+enum class RxOverflowPolicy {
+    Block,       // wait for a free slot; stalls the loop like an inline handler would
+    DropOldest,  // discard the oldest queued message to make room, or the
+                 // new one while the consumer still holds the slot it needs
+    Disconnect   // drop the message and reconnect the connection it came from
+};
+
+struct RxPipelineConfig {
+    // One consumer thread per entry, pinned to that core (-1: not pinned)
+    std::vector<int> consumerCores{-1};
+    // Per-consumer ring: number of preallocated messages and bytes per
+    // message. Larger messages grow their slot once.
+    size_t slots{4096};
+    size_t slotBytes{4096};
+    RxOverflowPolicy overflow{RxOverflowPolicy::Block};
+    // Polls of an empty ring before a consumer goes to sleep
+    int spinIterations{2000};
+    // Initial per-message arena of each consumer
+    size_t arenaBytes{64 * 1024};
+    // Consumer thread names get the consumer index appended
+    std::string name{"ws-rx"};
+};
+
+struct RxPipelineStats {
+    uint64_t enqueued{0};
+    uint64_t processed{0};
+    uint64_t dropped{0};    // DropOldest evictions and drops, Disconnect rejects
+    uint64_t overflows{0};  // pushes that found the ring full
+    size_t depth{0};
+    // Queue lag: time from the service thread enqueueing a message to a
+    // consumer picking it up
+    std::chrono::nanoseconds lastLag{0};
+    std::chrono::nanoseconds maxLag{0};
+    std::chrono::nanoseconds totalLag{0};
+};
+
+// Moves handler execution off the service thread. The service thread frames
+// a message, copies it once into a bounded lock-free ring and goes back to
+// lws; consumer threads run the handlers. Messages are sharded over the
+// consumers by stream key (or by connection when there is none), so the
+// messages of one channel are handled in order by one thread.
+//
+// One pipeline can be shared by any number of clients, also across loops.
+class RxPipeline {
+public:
+    explicit RxPipeline(const RxPipelineConfig& config = RxPipelineConfig());
+    ~RxPipeline();
+
+    RxPipeline(const RxPipeline&) = delete;
+    RxPipeline& operator=(const RxPipeline&) = delete;
+
+    // Queue msg for target. Returns false when the message was rejected
+    // under RxOverflowPolicy::Disconnect.
+    bool push(WsClient* client,
+              IClientHandler* target,
+              ParseMode mode,
+              std::string_view msg,
+              std::string_view key,
+              std::chrono::steady_clock::time_point receivedAt);
+
+    // Wait until no message of client is queued or being handled. Other
+    // clients of the pipeline are not waited for. A consumer thread cannot
+    // wait for its own ring: called from one of our handlers it logs an
+    // error and returns false without waiting.
+    bool flush(const WsClient* client);
+
+    size_t consumers() const { return consumers_.size(); }
+    RxPipelineStats stats() const;
+    // Summed over the consumers' arenas (peak and capacity: the largest)
+    MessageArenaStats arenaStats() const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::vector<char> buf;
+        size_t len{0};
+        WsClient* client{nullptr};
+        IClientHandler* target{nullptr};
+        ParseMode mode{ParseMode::Dom};
+        std::chrono::steady_clock::time_point enqueuedAt;
+        std::chrono::steady_clock::time_point receivedAt;  // for latency metrics
+    };
+
+    // Bounded MPMC ring (per-slot sequence numbers). Producers are the
+    // service threads; the consumer thread pops, and so does a producer
+    // evicting under DropOldest.
+    struct Ring {
+        Ring(size_t slots, size_t slotBytes);
+
+        Slot* claimPush(uint64_t& pos);
+        Slot* claimPop(uint64_t& pos);
+        void commitPush(Slot* slot, uint64_t pos) { slot->seq.store(pos + 1, std::memory_order_release); }
+        void release(Slot* slot, uint64_t pos) { slot->seq.store(pos + mask_ + 1, std::memory_order_release); }
+        size_t size() const;
+
+        size_t mask_{0};
+        std::unique_ptr<Slot[]> slots_;
+        alignas(64) std::atomic<uint64_t> enqueuePos_{0};
+        alignas(64) std::atomic<uint64_t> dequeuePos_{0};
+    };
+
+    struct Consumer {
+        Consumer(size_t slots, size_t slotBytes, size_t arenaBytes)
+            : ring(slots, slotBytes), arena(arenaBytes) {}
+
+        Ring ring;
+        std::thread thread;
+        int core{-1};
+        JsonDoc doc;  // index storage for OnDemand handlers of this thread
+        MessageArena arena;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<bool> sleeping{false};
+
+        // Written by the consumer thread only
+        std::atomic<uint64_t> processed{0};
+        std::atomic<int64_t> lastLagNs{0};
+        std::atomic<int64_t> maxLagNs{0};
+        std::atomic<int64_t> totalLagNs{0};
+    };
+
+    void run(Consumer& consumer, size_t index);
+    void idle(Consumer& consumer, int& spins);
+    void wake(Consumer& consumer);
+    static void done(const Slot& slot);
+
+    RxPipelineConfig config_;
+    std::vector<std::unique_ptr<Consumer>> consumers_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> overflows_{0};
+};
+
+} // namespace cexpp::util::wss
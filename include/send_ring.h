@@ -0,0 +1,133 @@
+// send_ring.h
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+// Bounded ring of preallocated outbound frames. Every slot keeps LWS_PRE bytes
+// of headroom in front of the payload so lws_write() can run straight from the
+// slot: a payload is copied exactly once, by the producer.
+//
+// The consumer side (the service thread) is always single. Producers are
+// either a single thread (Spsc) or any number of threads (Mpsc); both use the
+// per-slot sequence scheme, Mpsc additionally claims positions with a CAS.
+class SendRing {
+public:
+    enum class Mode { Spsc, Mpsc };
+
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::vector<unsigned char> buf;  // LWS_PRE + payload
+        size_t len{0};
+        std::chrono::steady_clock::time_point enqueuedAt;  // for queueing delay
+
+        unsigned char* payload() { return buf.data() + LWS_PRE; }
+    };
+
+    SendRing(size_t slots, size_t slotBytes, Mode mode)
+        : mode_(mode) {
+        size_t capacity = 1;
+        while (capacity < slots) {
+            capacity <<= 1;
+        }
+        mask_ = capacity - 1;
+        slots_ = std::make_unique<Slot[]>(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+            slots_[i].buf.resize(LWS_PRE + slotBytes);
+        }
+    }
+
+    SendRing(const SendRing&) = delete;
+    SendRing& operator=(const SendRing&) = delete;
+
+    // Producer: copy payload into the next free slot. Returns false when full.
+    bool push(std::string_view payload) {
+        uint64_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            const int64_t dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+            if (dif < 0) {
+                return false;
+            }
+            if (mode_ == Mode::Spsc) {
+                enqueuePos_.store(pos + 1, std::memory_order_relaxed);
+                break;
+            }
+            if (dif == 0 &&
+                enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+            if (dif > 0) {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Oversized payloads grow the slot once; the slot keeps the capacity
+        if (slot->buf.size() < LWS_PRE + payload.size()) {
+            slot->buf.resize(LWS_PRE + payload.size());
+        }
+        memcpy(slot->payload(), payload.data(), payload.size());
+        slot->len = payload.size();
+        slot->enqueuedAt = std::chrono::steady_clock::now();
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: oldest committed slot, or nullptr when empty
+    Slot* front() {
+        const uint64_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Slot* slot = &slots_[pos & mask_];
+        if (slot->seq.load(std::memory_order_acquire) != pos + 1) {
+            return nullptr;
+        }
+        return slot;
+    }
+
+    // Consumer: release the slot returned by front()
+    void pop() {
+        const uint64_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        slots_[pos & mask_].seq.store(pos + mask_ + 1, std::memory_order_release);
+        dequeuePos_.store(pos + 1, std::memory_order_release);
+    }
+
+    // Consumer: drop every queued frame
+    void clear() {
+        while (front()) {
+            pop();
+        }
+    }
+
+    // Approximate number of queued frames, safe from any thread
+    size_t size() const {
+        const uint64_t head = enqueuePos_.load(std::memory_order_relaxed);
+        const uint64_t tail = dequeuePos_.load(std::memory_order_acquire);
+        return head > tail ? static_cast<size_t>(head - tail) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask_ + 1; }
+    Mode mode() const { return mode_; }
+
+private:
+    Mode mode_;
+    size_t mask_{0};
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<uint64_t> enqueuePos_{0};
+    alignas(64) std::atomic<uint64_t> dequeuePos_{0};
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,82 @@
+// stream_router.h
+
+#pragma once
+
+#include "json_scanner.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+class IClientHandler;
+
+// Maps a stream key pulled out of the raw frame (e.g. the "stream" member of
+// a Binance combined stream) to the handler registered for that channel.
+// Keys live in a flat open-addressing table with cached hashes, so a lookup
+// is one hash over a short string plus, almost always, one probe.
+// Not thread safe: owned by the service thread.
+class StreamRouter {
+public:
+    struct Route {
+        // nullptr: no handler of its own, the client's handler gets it
+        IClientHandler* handler{nullptr};
+        ParseMode mode{ParseMode::Dom};
+
+        // Stale-feed watchdog, off when staleAfter is 0. seen counts
+        // messages; the watchdog compares it between checks, so the hot
+        // path needs no clock read.
+        std::chrono::milliseconds staleAfter{0};
+        uint64_t seen{0};
+        uint64_t seenAtCheck{0};
+        std::chrono::steady_clock::time_point lastProgress{};
+    };
+
+    // Fields whose string value is the routing key, tried in order
+    explicit StreamRouter(std::vector<std::string> fields = {"stream"},
+                          size_t scanBytes = 256);
+
+    void add(std::string_view key, IClientHandler* handler);
+    // Entry for key, created with no handler and no watchdog if missing
+    Route& insert(std::string_view key);
+    void remove(std::string_view key);
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    // Key of msg found by scanning its first scanBytes for "field":"value"
+    bool extractKey(std::string_view msg, std::string_view& key) const;
+
+    // Route for a key, nullptr when nobody registered it
+    const Route* find(std::string_view key) const;
+    Route* find(std::string_view key);
+
+    template <typename Fn>
+    void forEach(Fn&& fn) {  // fn(std::string_view key, Route& route)
+        for (auto& entry : table_) {
+            if (entry.hash) {
+                fn(std::string_view(entry.key), entry.route);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t hash{0};  // 0 marks a free slot
+        std::string key;
+        Route route;
+    };
+
+    static uint64_t hashKey(std::string_view key);
+    void rehash(size_t capacity);
+    void place(Entry&& entry);
+
+    std::vector<std::string> patterns_;  // "field":"
+    size_t scanBytes_;
+    std::vector<Entry> table_;
+    size_t mask_{0};
+    size_t size_{0};
+};
+
+} // namespace cexpp::util::wss
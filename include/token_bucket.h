@@ -0,0 +1,66 @@
+// token_bucket.h
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace cexpp::util::wss {
+
+// Classic token bucket: refills at `rate` tokens per second up to `burst`.
+// Not thread safe, owned by the service thread.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double ratePerSec = 0, double burst = 1)
+        : rate_(ratePerSec)
+        , burst_(std::max(burst, 1.0))
+        , tokens_(burst_)
+        , last_(Clock::now()) {}
+
+    // A zero rate disables limiting
+    bool enabled() const { return rate_ > 0; }
+
+    // Take one token if more than `reserve` would remain afterwards
+    bool tryTake(Clock::time_point now, double reserve = 0) {
+        if (!enabled()) {
+            return true;
+        }
+        refill(now);
+        if (tokens_ - 1.0 < reserve) {
+            return false;
+        }
+        tokens_ -= 1.0;
+        return true;
+    }
+
+    // Time until tryTake(reserve) can succeed
+    std::chrono::nanoseconds timeUntilToken(Clock::time_point now, double reserve = 0) {
+        if (!enabled()) {
+            return std::chrono::nanoseconds(0);
+        }
+        refill(now);
+        const double missing = 1.0 + reserve - tokens_;
+        if (missing <= 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        return std::chrono::nanoseconds(static_cast<int64_t>(missing / rate_ * 1e9) + 1);
+    }
+
+    double tokens() const { return tokens_; }
+
+private:
+    void refill(Clock::time_point now) {
+        const double elapsed = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    }
+
+    double rate_;
+    double burst_;
+    double tokens_;
+    Clock::time_point last_;
+};
+
+} // namespace cexpp::util::wss
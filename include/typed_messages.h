@@ -0,0 +1,462 @@
+// typed_messages.h
+
+#pragma once
+
+#include "websocket_client_base.h"
+#include "decimal.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+namespace cexpp::util::wss {
+
+// One JSON value found in place in a frame
+struct RawValue {
+    enum class Kind { String, Number, True, False, Null, Object, Array };
+
+    Kind kind{Kind::Null};
+    // String contents without the quotes (escapes untouched), or the literal
+    // text of anything else, nested objects and arrays included
+    std::string_view text;
+    bool escaped{false};  // a string holding backslash escapes
+};
+
+// Scan the value starting at json[pos] (leading blanks allowed). Returns
+// the position just past it, or std::string_view::npos when malformed.
+size_t scanValue(std::string_view json, size_t pos, RawValue& out);
+size_t skipBlanks(std::string_view json, size_t pos);
+
+// fn(std::string_view key, const RawValue& value) for each member of the
+// object text, in order; fn returns false to stop early. Keys holding
+// escapes are passed as is. False when the text is malformed.
+template <typename Fn>
+bool forEachMember(std::string_view object, Fn&& fn) {
+    size_t pos = skipBlanks(object, 0);
+    if (pos >= object.size() || object[pos] != '{') {
+        return false;
+    }
+    pos = skipBlanks(object, pos + 1);
+    if (pos < object.size() && object[pos] == '}') {
+        return true;
+    }
+    for (;;) {
+        RawValue key;
+        pos = scanValue(object, pos, key);
+        if (pos == std::string_view::npos || key.kind != RawValue::Kind::String) {
+            return false;
+        }
+        pos = skipBlanks(object, pos);
+        if (pos >= object.size() || object[pos] != ':') {
+            return false;
+        }
+        RawValue value;
+        pos = scanValue(object, pos + 1, value);
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        if (!fn(key.text, value)) {
+            return true;
+        }
+        pos = skipBlanks(object, pos);
+        if (pos >= object.size()) {
+            return false;
+        }
+        if (object[pos] == '}') {
+            return true;
+        }
+        if (object[pos] != ',') {
+            return false;
+        }
+        pos = skipBlanks(object, pos + 1);
+    }
+}
+
+// fn(const RawValue& element) for each element of the array text, as
+// forEachMember
+template <typename Fn>
+bool forEachElement(std::string_view array, Fn&& fn) {
+    size_t pos = skipBlanks(array, 0);
+    if (pos >= array.size() || array[pos] != '[') {
+        return false;
+    }
+    pos = skipBlanks(array, pos + 1);
+    if (pos < array.size() && array[pos] == ']') {
+        return true;
+    }
+    for (;;) {
+        RawValue value;
+        pos = scanValue(array, pos, value);
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        if (!fn(value)) {
+            return true;
+        }
+        pos = skipBlanks(array, pos);
+        if (pos >= array.size()) {
+            return false;
+        }
+        if (array[pos] == ']') {
+            return true;
+        }
+        if (array[pos] != ',') {
+            return false;
+        }
+        pos = skipBlanks(array, pos + 1);
+    }
+}
+
+// Fixed-point decimal with a compile-time number of decimals
+template <int Decimals>
+struct Fixed {
+    static_assert(Decimals >= 0 && Decimals <= 18, "Fixed supports 0..18 decimals");
+    static constexpr int decimals = Decimals;
+
+    int64_t value{0};
+
+    double toDouble() const {
+        double scale = 1.0;
+        for (int i = 0; i < Decimals; ++i) {
+            scale *= 10.0;
+        }
+        return static_cast<double>(value) / scale;
+    }
+};
+
+// [["price","qty"],...] as found in the frame, parsed while iterated.
+// Only valid during the callback that received it.
+class LevelArray {
+public:
+    bool empty() const { return size() == 0; }
+    size_t size() const;
+
+    // fn(T price, T quantity) per level, T being double or Fixed<N>.
+    // False when a level does not parse; the levels before it were visited.
+    template <typename T = double, typename Fn>
+    bool forEach(Fn&& fn) const;
+
+    void assign(std::string_view text) { text_ = text; }
+
+private:
+    std::string_view text_;
+};
+
+bool decodeValue(const RawValue& value, std::string_view& out);
+bool decodeValue(const RawValue& value, int64_t& out);
+bool decodeValue(const RawValue& value, uint64_t& out);
+bool decodeValue(const RawValue& value, bool& out);
+bool decodeValue(const RawValue& value, double& out);
+bool decodeValue(const RawValue& value, LevelArray& out);
+
+template <int Decimals>
+bool decodeValue(const RawValue& value, Fixed<Decimals>& out) {
+    return (value.kind == RawValue::Kind::String || value.kind == RawValue::Kind::Number) &&
+           parseFixedPoint(value.text, Decimals, out.value);
+}
+
+template <typename T, typename Fn>
+bool LevelArray::forEach(Fn&& fn) const {
+    bool ok = true;
+    forEachElement(text_, [&](const RawValue& level) {
+        T price{};
+        T quantity{};
+        int n = 0;
+        // [price, quantity], anything after them is ignored
+        ok = level.kind == RawValue::Kind::Array && forEachElement(level.text, [&](const RawValue& v) {
+            ok = ++n == 1 ? decodeValue(v, price) : decodeValue(v, quantity);
+            return ok && n < 2;
+        }) && ok && n == 2;
+        if (ok) {
+            fn(price, quantity);
+        }
+        return ok;
+    });
+    return ok;
+}
+
+// Field name bound to a member; see MessageSchema
+template <typename T, typename M>
+struct FieldBinding {
+    std::string_view name;
+    M T::*member;
+};
+
+template <typename T, typename M>
+constexpr FieldBinding<T, M> field(std::string_view name, M T::*member) {
+    return {name, member};
+}
+
+// Specialise for every message struct:
+//     template <> struct MessageSchema<Trade> {
+//         static constexpr std::string_view event = "trade";  // "e" value
+//         static constexpr auto fields = std::make_tuple(
+//             field("p", &Trade::price), field("q", &Trade::quantity), ...);
+//     };
+// A schema whose event is empty matches frames without "e", and must also
+// declare the key member every such frame carries, e.g.
+//         static constexpr std::string_view key = "u";
+// so that subscribe acks and other replies are not taken for it.
+// Members may be std::string_view (valid during the callback, no escapes),
+// int64_t, uint64_t, bool, double, Fixed<N> or LevelArray. Numbers may come
+// quoted, as exchanges send prices.
+template <typename T>
+struct MessageSchema;
+
+// True when object can be of type T: an event-typed schema needs nothing
+// more than the event, a schema without one needs its key member present
+template <typename T>
+bool carriesKey(std::string_view object) {
+    if constexpr (MessageSchema<T>::event.empty()) {
+        static_assert(!MessageSchema<T>::key.empty(), "a schema without an event needs a key member");
+        bool found = false;
+        forEachMember(object, [&found](std::string_view key, const RawValue&) {
+            found = key == MessageSchema<T>::key;
+            return !found;
+        });
+        return found;
+    } else {
+        (void)object;
+        return true;
+    }
+}
+
+// Fill out from a JSON object in one pass over the frame. Each member name
+// is compared against the schema's bindings, which the compiler unrolls;
+// unknown members are skipped, missing ones keep their value. False when
+// the object is malformed or a bound member has the wrong type or format.
+template <typename T>
+bool decodeMessage(std::string_view object, T& out) {
+    bool ok = true;
+    const bool wellFormed = forEachMember(object, [&](std::string_view key, const RawValue& value) {
+        std::apply(
+            [&](const auto&... binding) {
+                (void)((key == binding.name && (ok = decodeValue(value, out.*(binding.member)) && ok, true)) || ...);
+            },
+            MessageSchema<T>::fields);
+        return true;
+    });
+    return wellFormed && ok;
+}
+
+// Binance spot market data
+
+// <symbol>@ticker
+struct Ticker {
+    int64_t eventTime{0};
+    std::string_view symbol;
+    double priceChange{0};
+    double priceChangePercent{0};
+    double lastPrice{0};
+    double lastQuantity{0};
+    double bidPrice{0};
+    double bidQuantity{0};
+    double askPrice{0};
+    double askQuantity{0};
+    double openPrice{0};
+    double highPrice{0};
+    double lowPrice{0};
+    double volume{0};
+    double quoteVolume{0};
+    uint64_t tradeCount{0};
+};
+
+template <>
+struct MessageSchema<Ticker> {
+    static constexpr std::string_view event = "24hrTicker";
+    static constexpr auto fields = std::make_tuple(
+        field("E", &Ticker::eventTime),
+        field("s", &Ticker::symbol),
+        field("p", &Ticker::priceChange),
+        field("P", &Ticker::priceChangePercent),
+        field("c", &Ticker::lastPrice),
+        field("Q", &Ticker::lastQuantity),
+        field("b", &Ticker::bidPrice),
+        field("B", &Ticker::bidQuantity),
+        field("a", &Ticker::askPrice),
+        field("A", &Ticker::askQuantity),
+        field("o", &Ticker::openPrice),
+        field("h", &Ticker::highPrice),
+        field("l", &Ticker::lowPrice),
+        field("v", &Ticker::volume),
+        field("q", &Ticker::quoteVolume),
+        field("n", &Ticker::tradeCount));
+};
+
+// <symbol>@trade
+struct Trade {
+    int64_t eventTime{0};
+    std::string_view symbol;
+    uint64_t tradeId{0};
+    double price{0};
+    double quantity{0};
+    int64_t tradeTime{0};
+    bool buyerIsMaker{false};
+};
+
+template <>
+struct MessageSchema<Trade> {
+    static constexpr std::string_view event = "trade";
+    static constexpr auto fields = std::make_tuple(
+        field("E", &Trade::eventTime),
+        field("s", &Trade::symbol),
+        field("t", &Trade::tradeId),
+        field("p", &Trade::price),
+        field("q", &Trade::quantity),
+        field("T", &Trade::tradeTime),
+        field("m", &Trade::buyerIsMaker));
+};
+
+// <symbol>@bookTicker
+struct BookTicker {
+    uint64_t updateId{0};
+    std::string_view symbol;
+    double bidPrice{0};
+    double bidQuantity{0};
+    double askPrice{0};
+    double askQuantity{0};
+};
+
+template <>
+struct MessageSchema<BookTicker> {
+    // Spot book tickers carry no event type, only an update id
+    static constexpr std::string_view event = "";
+    static constexpr std::string_view key = "u";
+    static constexpr auto fields = std::make_tuple(
+        field("u", &BookTicker::updateId),
+        field("s", &BookTicker::symbol),
+        field("b", &BookTicker::bidPrice),
+        field("B", &BookTicker::bidQuantity),
+        field("a", &BookTicker::askPrice),
+        field("A", &BookTicker::askQuantity));
+};
+
+// <symbol>@depth, <symbol>@depth@100ms
+struct DepthUpdate {
+    int64_t eventTime{0};
+    std::string_view symbol;
+    uint64_t firstUpdateId{0};
+    uint64_t finalUpdateId{0};
+    LevelArray bids;
+    LevelArray asks;
+};
+
+template <>
+struct MessageSchema<DepthUpdate> {
+    static constexpr std::string_view event = "depthUpdate";
+    static constexpr auto fields = std::make_tuple(
+        field("E", &DepthUpdate::eventTime),
+        field("s", &DepthUpdate::symbol),
+        field("U", &DepthUpdate::firstUpdateId),
+        field("u", &DepthUpdate::finalUpdateId),
+        field("b", &DepthUpdate::bids),
+        field("a", &DepthUpdate::asks));
+};
+
+// Handler decoding raw frames straight into schema structs: register a
+// callback per message type with on<T>(). Nothing is parsed ahead of the
+// decode, no DOM or index is built, and nothing is allocated. The "e"
+// member picks the schema; frames without one only match a schema whose
+// event is empty and whose key member they carry, so subscribe acks go
+// unmatched. A frame whose first member is
+// "stream" is a combined-stream envelope, its "data" member is decoded.
+//
+//     TypedDispatcher<Trade, BookTicker> handler;
+//     handler.on<Trade>([](const Trade& t) { ... });
+//
+// Override genSubscribePayload() to use it as a client's main handler.
+template <typename... Msgs>
+class TypedDispatcher : public IClientHandler {
+public:
+    static_assert(sizeof...(Msgs) > 0, "TypedDispatcher needs at least one message type");
+
+    template <typename T>
+    using Callback = std::function<void(const T&)>;
+
+    template <typename T>
+    void on(Callback<T> fn) { std::get<Callback<T>>(callbacks_) = std::move(fn); }
+
+    // Decode one frame, e.g. from a replay. False when it was rejected or
+    // of no known type.
+    bool onFrame(std::string_view msg) {
+        std::string_view data;
+        if (!unwrap(msg, data)) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // "e" leads every event, so this rarely looks past the first member
+        std::string_view event;
+        forEachMember(data, [&event](std::string_view key, const RawValue& value) {
+            if (key == "e") {
+                event = value.text;
+                return false;
+            }
+            return true;
+        });
+        bool matched = false;
+        bool ok = true;
+        (void)((event == MessageSchema<Msgs>::event && carriesKey<Msgs>(data) &&
+                (matched = true, ok = deliver<Msgs>(data), true)) || ...);
+        if (!matched) {
+            unmatched_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return matched && ok;
+    }
+
+    // Frames that were malformed or failed to decode, and frames of no
+    // known type
+    uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+    uint64_t unmatched() const { return unmatched_.load(std::memory_order_relaxed); }
+
+    // IClientHandler
+    ParseMode parseMode() const override { return ParseMode::Raw; }
+    bool onRawMessage(std::string_view msg) override {
+        onFrame(msg);
+        return true;
+    }
+    void onUpdate() override {}
+    void onMessage(const nlohmann::json&) override {}
+    void onMessage(const std::string&) override {}
+    std::string genSubscribePayload(const std::string&, bool) override { return {}; }
+
+private:
+    static bool unwrap(std::string_view msg, std::string_view& data) {
+        data = msg;
+        bool first = true;
+        bool envelope = false;
+        const bool ok = forEachMember(msg, [&](std::string_view key, const RawValue& value) {
+            if (first) {
+                first = false;
+                envelope = key == "stream";
+                return envelope;
+            }
+            if (key == "data" && value.kind == RawValue::Kind::Object) {
+                data = value.text;
+                return false;
+            }
+            return true;
+        });
+        return ok && (!envelope || data.data() != msg.data());
+    }
+
+    template <typename T>
+    bool deliver(std::string_view data) {
+        T msg{};
+        if (!decodeMessage(data, msg)) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (const auto& fn = std::get<Callback<T>>(callbacks_)) {
+            fn(msg);
+        }
+        return true;
+    }
+
+    std::tuple<Callback<Msgs>...> callbacks_;
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> unmatched_{0};
+};
+
+} // namespace cexpp::util::wss
@@ -6,12 +6,21 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "json_scanner.h"
+#include "msg_arena.h"
 
 namespace cexpp::util::wss
 {
-    extern bool wsLogEnabled;
+    // The per-category levels of ws_log.h decide what is logged.
+    // setWsLogEnabled() sets all of them at once, to Info or Off; a later
+    // setLogLevel() overrides it for one category. wsLogEnabled only
+    // reflects the last setWsLogEnabled() call.
+    extern std::atomic<bool> wsLogEnabled;
     void setWsLogEnabled(bool enabled);
 
     // Handler
@@ -21,7 +30,20 @@ namespace cexpp::util::wss
         virtual void onUpdate() = 0;
         virtual void onMessage(const nlohmann::json &payload) = 0;
         virtual void onMessage(const std::string &payload) = 0;
+        // 完整消息（分片已重组）的零拷贝视图，仅在本次回调内有效
+        // 返回true表示已处理，不再进行json解析
+        virtual bool onRawMessage(std::string_view /*payload*/) { return false; }
+
+        // 消息交付方式：Dom（默认，onMessage(json)）、OnDemand（onDocument）、Raw（onRawMessage）、Arena（onArenaMessage）
+        virtual ParseMode parseMode() const { return ParseMode::Dom; }
+        // OnDemand模式：基于结构索引按需取字段，doc仅在本次回调内有效
+        virtual void onDocument(const JsonDoc & /*doc*/) {}
+        // Arena模式：DOM分配在每条消息的arena中（无堆分配），json仅在本次回调内有效，不可保留或拷贝到回调外
+        virtual void onArenaMessage(const ArenaJson & /*json*/) {}
         virtual std::string genSubscribePayload(const std::string &name, bool unSub) = 0;
+        // 一帧内订阅/反订阅多个频道（如Binance的params数组）
+        // 返回空串表示不支持，此时退化为逐个频道调用genSubscribePayload
+        virtual std::string genBatchSubscribePayload(const std::vector<std::string> & /*names*/, bool /*unSub*/) { return {}; }
     };
 
     class ClientBase
@@ -64,6 +86,28 @@ namespace cexpp::util::wss
                                         std::string_view successKey,
                                         bool waitOk) = 0;
 
+        // 批量订阅，payload由genBatchSubscribePayload按帧生成
+        // 默认实现逐个频道调用subscribeDynamic
+        virtual void subscribeMany(const std::vector<std::string> &names,
+                                   std::string_view successKey,
+                                   bool waitOk)
+        {
+            for (const auto &name : names)
+            {
+                subscribeDynamic(name, successKey, waitOk);
+            }
+        }
+
+        virtual void unSubscribeMany(const std::vector<std::string> &names,
+                                     std::string_view successKey,
+                                     bool waitOk)
+        {
+            for (const auto &name : names)
+            {
+                unSubscribeDynamic(name, successKey, waitOk);
+            }
+        }
+
         // 查询某个频道是否订阅/反订阅ok
         virtual bool isSubscribeOk(std::string_view name) = 0;
         virtual bool isUnsubscribeOk(std::string_view name) = 0;
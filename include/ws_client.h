@@ -3,6 +3,16 @@
 #pragma once
 
 #include "websocket_client_base.h"
+#include "ws_rx_buffer.h"
+#include "send_ring.h"
+#include "token_bucket.h"
+#include "stream_router.h"
+#include "rx_pipeline.h"
+#include "feed_dedup.h"
+#include "frame_capture.h"
+#include "latency_histogram.h"
+#include "dns_cache.h"
+#include "ws_event_loop.h"
 #include <libwebsockets.h>
 #include <atomic>
 #include <thread>
@@ -13,24 +23,252 @@
 #include <chrono>
 #include <functional>
 #include <vector>
+#include <random>
 
 namespace cexpp::util::wss {
 
-// Forward declaration of callback
-int wsCallback(struct lws* wsi,
-               enum lws_callback_reasons reason,
-               void* user,
-               void* in,
-               size_t len);
-
 struct SubscribeRequest {
+    SubscribeRequest() = default;
+    SubscribeRequest(std::string name, std::string payload, std::string successKey, bool waitOk,
+                     bool isUnsubscribe, std::chrono::steady_clock::time_point lastTryTime)
+        : name(std::move(name))
+        , payload(std::move(payload))
+        , successKey(std::move(successKey))
+        , waitOk(waitOk)
+        , isUnsubscribe(isUnsubscribe)
+        , lastTryTime(lastTryTime) {}
+
     std::string name;
     std::string payload;
     std::string successKey;
-    bool waitOk;
-    bool isUnsubscribe;
+    bool waitOk{false};
+    bool isUnsubscribe{false};
     std::chrono::steady_clock::time_point lastTryTime;
     int retryCount{0};
+    // Request id found in the payload ("id":N); acks are matched on it.
+    // Requests without one get a local key and are matched by successKey.
+    uint64_t id{0};
+    bool hasId{false};
+    // Payload comes from IClientHandler::genSubscribePayload and is
+    // regenerated on resubscribe
+    bool dynamic{false};
+    // Channels covered by a batch frame; empty for a single-channel request.
+    // The ack of the frame settles all of them.
+    std::vector<std::string> names;
+    std::chrono::steady_clock::time_point firstTryTime;
+};
+
+struct SubscribeStats {
+    uint64_t sent{0};      // requests started
+    uint64_t acked{0};
+    uint64_t failed{0};    // error ack or out of retries
+    uint64_t retries{0};
+    size_t inFlight{0};
+    std::chrono::nanoseconds lastAckLatency{0};  // first send to ack
+    std::chrono::nanoseconds maxAckLatency{0};
+};
+
+enum class BackpressurePolicy {
+    Reject,  // trySend() fails once the queue is at the high-water mark
+    Notify   // queue until the ring is full, only report congestion
+};
+
+enum class ConnectionState {
+    Connecting,  // wsi created, waiting for the handshake
+    Connected,
+    Backoff,     // disconnected, reconnect timer armed
+    Stopped
+};
+
+// Outage accounting: an outage runs from losing an established connection
+// to the next successful handshake, across however many attempts it took
+struct ReconnectStats {
+    uint64_t reconnects{0};     // outages that ended in a new connection
+    uint64_t attempts{0};       // connection attempts made while reconnecting
+    std::chrono::nanoseconds lastOutage{0};
+    std::chrono::nanoseconds maxOutage{0};
+    std::chrono::nanoseconds totalOutage{0};
+    std::string address;        // of the current or last connection
+};
+
+// Outbound lanes. High carries user sends, Bulk the subscription traffic the
+// client generates itself; High always goes first.
+enum class SendPriority { High, Bulk };
+
+struct SendLaneStats {
+    uint64_t sent{0};
+    // Time from enqueue to lws_write, including any rate limiter wait
+    std::chrono::nanoseconds lastQueueDelay{0};
+    std::chrono::nanoseconds maxQueueDelay{0};
+    std::chrono::nanoseconds totalQueueDelay{0};
+};
+
+struct SendStats {
+    SendLaneStats high;
+    SendLaneStats bulk;
+    uint64_t throttled{0};  // drains cut short by the rate limiter
+};
+
+// permessage-deflate accounting of one client, zero when not negotiated
+struct CompressionStats {
+    uint64_t compressedBytes{0};    // payload bytes fed to inflate
+    uint64_t decompressedBytes{0};  // bytes inflate produced
+    std::chrono::nanoseconds inflateTime{0};
+};
+
+// Per-connection receive path latency, see WsClientConfig::latencyMetrics.
+// Stages: callback entry of the first fragment -> message complete
+// (reassembly) -> parsed (parse, from the start of the dispatch) -> handler
+// returned (handler). total runs from callback entry to handler return and
+// includes any RxPipeline queueing.
+struct LatencyMetrics {
+    HistogramSnapshot reassembly;
+    HistogramSnapshot parse;
+    HistogramSnapshot handler;
+    HistogramSnapshot total;
+    // Local receive wall time minus the exchange event time; negative
+    // deltas are recorded as 0 and counted
+    HistogramSnapshot exchange;
+    std::chrono::nanoseconds lastExchangeDelay{0};
+    uint64_t negativeExchangeDelays{0};
+    // Estimated local-minus-exchange clock offset (including the minimum
+    // path delay): exchange - clockOffset approximates the queueing and
+    // network delay on top of the fastest path
+    std::chrono::nanoseconds clockOffset{0};
+};
+
+// What the watchdog does about a watched stream that went silent
+enum class StaleAction {
+    Reconnect,  // reconnect; the subscriptions are restored afterwards
+    Notify      // only report it (stale stream callback), e.g. to fail over
+};
+
+// Protocol-level liveness of one client, see WsClientConfig::pingInterval
+struct LivenessStats {
+    uint64_t pingsSent{0};
+    uint64_t pongsReceived{0};
+    uint64_t pongTimeouts{0};  // each one triggered a reconnect
+    uint64_t staleEvents{0};   // watched streams found silent
+    std::chrono::nanoseconds lastRtt{0};
+    std::chrono::nanoseconds minRtt{0};
+    std::chrono::nanoseconds maxRtt{0};
+    std::chrono::nanoseconds avgRtt{0};
+};
+
+struct WsClientConfig {
+    // Event loop to run on. Clients sharing a loop share one lws_context and
+    // one service thread; nullptr gives the client a private loop.
+    std::shared_ptr<WsEventLoop> loop;
+    // Settings of the private loop (mode, core), unused when loop is set
+    WsEventLoopConfig loopConfig;
+
+    // Outbound ring: number of preallocated frames and payload bytes per frame.
+    // Larger payloads grow their slot once.
+    size_t sendRingSlots{256};
+    size_t sendSlotBytes{1024};
+    // Mpsc allows send() from any number of threads. Only clear it when a single
+    // thread calls send(); subscription traffic has its own lane.
+    bool multiProducerSend{true};
+    // Subscription (bulk lane) ring, filled by the service thread only
+    size_t bulkRingSlots{1024};
+
+    // Outbound rate limit in frames per second over both lanes, 0 disables it.
+    // Exchanges cap this per connection (Binance: 5/s) and disconnect offenders.
+    double sendRateLimit{0};
+    double sendRateBurst{5};
+    // Tokens the bulk lane must leave in the bucket, so a resubscribe storm
+    // never leaves a high priority send waiting for a full refill. Capped at
+    // sendRateBurst - 1, a larger reserve would starve the bulk lane.
+    double bulkLaneReserve{1};
+
+    // Queue depth (frames) at which the connection counts as congested,
+    // until it drains to half of it. 0 means only the ring capacity limits
+    // the queue.
+    size_t sendHighWaterMark{0};
+    BackpressurePolicy backpressurePolicy{BackpressurePolicy::Reject};
+
+    // Upper bound on frames written per WRITEABLE callback, keeps one busy
+    // connection from starving the others on the same service loop
+    int maxWritesPerCallback{64};
+
+    // Reconnect backoff: base * 2^attempt capped at max, randomized by
+    // +/- jitter (fraction of the delay) so many clients don't retry in lockstep
+    std::chrono::milliseconds reconnectBaseDelay{200};
+    std::chrono::milliseconds reconnectMaxDelay{30000};
+    double reconnectJitter{0.2};
+
+    // Maximum channels packed into one subscribeMany()/resubscribe frame
+    size_t subscribeBatchSize{100};
+
+    // Routing key for addRoute()/subscribeRouted(): the string value of the
+    // first of these fields found within the first routeScanBytes of a frame
+    // ("stream" for combined streams, "s" for the symbol, ...)
+    std::vector<std::string> routeFields{"stream"};
+    size_t routeScanBytes{256};
+    // Drop frames whose key has no route instead of passing them to the
+    // client's own handler
+    bool dropUnrouted{false};
+
+    // Run handlers on the pipeline's consumer threads instead of the service
+    // thread. nullptr keeps them inline. Subscribe acks are still handled on
+    // the service thread. Handlers must then be thread safe against
+    // everything else they share, and must not wait on the service thread.
+    // The client's destructor waits for its queued messages, so a handler
+    // run by the pipeline must not destroy a client of that pipeline.
+    std::shared_ptr<RxPipeline> rxPipeline;
+
+    // Redundant leg: this client is leg dedupLeg of a deduplicator shared
+    // with other connections to the same streams, and only delivers the
+    // updates it receives first. See RedundantWsClient.
+    std::shared_ptr<FeedDeduplicator> dedup;
+    size_t dedupLeg{0};
+    // Address (IP) to connect to instead of the url's host, which is still
+    // sent as Host header and TLS server name. Empty: the url's host.
+    std::string connectAddress;
+    // Start this many places into the host's ranked addresses (wrapping),
+    // the ones skipped stay as fallbacks. Redundant legs use it to spread
+    // over the addresses.
+    size_t addressOffset{0};
+
+    // Resolver of the url's host, shared with other clients; nullptr:
+    // DnsCache::shared(). No lookup ever blocks the service thread.
+    std::shared_ptr<DnsCache> dnsCache;
+    // Happy eyeballs (RFC 8305) over the host's addresses, fastest first:
+    // when an attempt has no handshake after connectAttemptDelay the next
+    // address is tried alongside, up to parallelConnects at a time. The
+    // first handshake wins and the others are dropped. A failed attempt
+    // moves on at once. Unused with connectAddress.
+    std::chrono::milliseconds connectAttemptDelay{250};
+    size_t parallelConnects{2};
+
+    // Append every received message to this capture, tagged with
+    // recordConnection. Costs a clock read and a copy per message.
+    std::shared_ptr<FrameRecorder> recorder;
+    uint32_t recordConnection{0};
+    // Open the connection on construction. An offline client only handles
+    // what is fed to processMessage(), e.g. by a FrameReplayer.
+    bool autoConnect{true};
+
+    // Record LatencyMetrics: a few clock reads and histogram updates per
+    // message
+    bool latencyMetrics{false};
+    // Exchange event time field (ms, us or ns since the epoch, told apart by
+    // magnitude) looked for in the first 256 bytes; empty disables it
+    std::string eventTimeField{"E"};
+
+    // Send a ping every pingInterval (0: never) and reconnect when its pong
+    // is later than pongTimeout. Pings take a token from the rate limiter.
+    std::chrono::milliseconds pingInterval{0};
+    std::chrono::milliseconds pongTimeout{5000};
+    // Watch every acknowledged subscription: a stream without a message for
+    // this long is stale (0: only streams passed to watchStream()). Needs
+    // routing keys equal to the subscription names, as with combined streams.
+    std::chrono::milliseconds staleStreamTimeout{0};
+    StaleAction staleAction{StaleAction::Reconnect};
+
+    // Initial per-message arena for inline dispatch (not Dom mode); grows to
+    // the largest message seen, only allocated once used
+    size_t arenaBytes{64 * 1024};
 };
 
 class WsClient : public ClientBase, public std::enable_shared_from_this<WsClient> {
@@ -39,11 +277,18 @@ public:
              std::string_view url,
              std::string_view path,
              uint16_t port = 443,
-             bool useSSL = true);
+             bool useSSL = true,
+             const WsClientConfig& config = WsClientConfig());
     ~WsClient();
 
     void reconnect(std::string_view reason) override;
     void send(std::string_view payload) const override;
+
+    // Like send() but reports whether the frame was queued. Fails when the ring
+    // is full or, with BackpressurePolicy::Reject, at the high-water mark.
+    bool trySend(std::string_view payload) const;
+    size_t sendQueueDepth() const;
+    SendStats sendStats() const;
     
     void subscribe(std::string_view name,
                   std::string_view payload,
@@ -62,51 +307,254 @@ public:
     void unSubscribeDynamic(std::string_view name,
                            std::string_view successKey,
                            bool waitOk) override;
+
+    // Packs up to WsClientConfig::subscribeBatchSize channels per frame
+    void subscribeMany(const std::vector<std::string>& names,
+                       std::string_view successKey,
+                       bool waitOk) override;
+
+    void unSubscribeMany(const std::vector<std::string>& names,
+                         std::string_view successKey,
+                         bool waitOk) override;
                            
+    ConnectionState connectionState() const { return state_.load(); }
+    ReconnectStats reconnectStats() const;
+
+    SubscribeStats subscribeStats() const;
+
+    // Histogram snapshots, safe to call while messages keep flowing.
+    // Empty unless WsClientConfig::latencyMetrics is set.
+    LatencyMetrics latencyMetrics() const;
+
+    // Inflate work of this client, see WsEventLoopConfig::deflate
+    CompressionStats compressionStats() const;
+
+    // Ping round trips and stale stream events
+    LivenessStats livenessStats() const;
+
+    // Addresses behind the url's host, in the order the next connect tries them
+    std::vector<EndpointStats> endpointStats() const;
+
+    // Per-message arena of inline dispatch; with an rxPipeline see
+    // RxPipeline::arenaStats()
+    MessageArenaStats arenaStats() const;
+
+    // Per-channel handlers, picked by the routing key without parsing.
+    // A route goes away with a successful unsubscribe of the channel.
+    void addRoute(std::string_view channel, IClientHandler* channelHandler);
+    void removeRoute(std::string_view channel);
+    void subscribeRouted(std::string_view name,
+                         IClientHandler* channelHandler,
+                         std::string_view successKey,
+                         bool waitOk);
+
+    // Report stream (a routing key) as stale after timeout without a
+    // message; a timeout of 0 stops watching it. Checked on the service
+    // thread, the receive path only bumps a counter.
+    void watchStream(std::string_view stream, std::chrono::milliseconds timeout);
+
     bool isSubscribeOk(std::string_view name) override;
     bool isUnsubscribeOk(std::string_view name) override;
 
     // Make these public for the callback
-    void processMessage(const std::string& msg);
+    void processMessage(std::string_view msg);
 
     void setSubscriptionCallback(std::function<void(const std::string&, bool)> callback);
     void setUnsubscriptionCallback(std::function<void(const std::string&, bool)> callback);
+    // Called with (depth, true) when the send queue reaches the high-water mark
+    // and with (depth, false) once it has drained below half of it
+    void setBackpressureCallback(std::function<void(size_t, bool)> callback);
+    // Called on the service thread with the stream and its silence, before
+    // StaleAction::Reconnect acts on it
+    void setStaleStreamCallback(std::function<void(const std::string&, std::chrono::milliseconds)> callback);
     void processEvents();
 
 protected:
     using ClientBase::handler;  // Make handler accessible
 
 private:
+    struct ConnectAttempt {
+        struct lws* wsi{nullptr};
+        std::string address;
+        std::chrono::steady_clock::time_point start;
+    };
+
     void connect();
-    void disconnect();
-    void processSubscribeQueue();
-    void handleSubscribeResponse(const std::string& msg);
+    void lookupAndAttempt();
+    void startAttempt();
+    void onAttemptTimer();
+    ConnectAttempt* findAttempt(struct lws* wsi);
+    bool onAttemptEstablished(struct lws* wsi);
+    void onAttemptFailed(struct lws* wsi);
+    void dropAttempts();
+    void shutdown();
+    void onReconnectTimer();
+    void onConnected();
+    void onDisconnected();
+    std::chrono::microseconds nextBackoff();
+    void startSubscribe(SubscribeRequest req);
+    bool makeBatches(const std::vector<std::string>& names,
+                     std::string_view successKey,
+                     bool waitOk,
+                     bool unSub,
+                     std::vector<SubscribeRequest>& out);
+    void sendSubscribe(SubscribeRequest& req);
+    void completeSubscribe(SubscribeRequest& req, bool ok);
+    void resubscribeAll();
+    void onSubscribeTimer();
+    void armSubscribeTimer();
+    void sendBulk(std::string_view payload);
+    void deliver(IClientHandler* target,
+                 ParseMode mode,
+                 std::string_view msg,
+                 std::string_view key,
+                 std::chrono::steady_clock::time_point receivedAt);
+    void dispatch(IClientHandler* target,
+                  ParseMode mode,
+                  std::string_view msg,
+                  JsonDoc& doc,
+                  MessageArena& arena,
+                  std::chrono::steady_clock::time_point receivedAt);
+    void stampReceive();
+    void recordEventTime(std::string_view msg);
+    int drainSendQueues(struct lws* wsi);
+    void onPingTimer();
+    void onPong(const void* payload, size_t len);
+    int writePing(struct lws* wsi);
+    void armWatchdog();
+    void onWatchdogTimer();
+    void handleSubscribeResponse(std::string_view msg);
 
     // Connection related
     std::string url_;
     std::string path_;
     uint16_t port_;
     bool useSSL_;
+    WsClientConfig config_;
     
-    // libwebsockets context
-    struct lws_context* context_{nullptr};
+    // Event loop owning the lws_context; connection_ is only touched on its
+    // service thread
+    std::shared_ptr<WsEventLoop> loop_;
     struct lws* connection_{nullptr};
-    struct lws_protocols protocols_[2];  // One for ws, one for null termination
     
-    // Threading
+    // Connection attempts of the current connect, service thread only.
+    // candidates_ holds the addresses not tried yet, best first; the wsi of
+    // an attempt being created is pendingWsi_ until lws returns it.
+    std::shared_ptr<DnsCache> dnsCache_;
+    std::vector<std::string> candidates_;
+    size_t nextCandidate_{0};
+    std::vector<ConnectAttempt> attempts_;
+    struct lws* pendingWsi_{nullptr};
+    LoopTimer attemptTimer_;
+    static constexpr auto RESOLVE_POLL_INTERVAL = std::chrono::milliseconds(5);
+    
+    // Reconnect state machine, driven by reconnectTimer_ on the service thread
+    std::atomic<ConnectionState> state_{ConnectionState::Connecting};
+    LoopTimer reconnectTimer_;
+    int reconnectAttempt_{0};
+    std::chrono::steady_clock::time_point outageStart_{};
+    std::minstd_rand backoffRng_{std::random_device{}()};
+    mutable std::mutex reconnectStatsMutex_;
+    ReconnectStats reconnectStats_;
+
+    // Reassembly buffer for fragmented messages, only touched by the service thread
+    RxBuffer rxBuffer_;
+    
+    // Latency histograms, only allocated when enabled. The stamps of the
+    // message being received belong to the service thread.
+    struct LatencyRecorder {
+        static constexpr auto OFFSET_WINDOW = std::chrono::seconds(10);
+        
+        LatencyHistogram reassembly;
+        LatencyHistogram parse;
+        LatencyHistogram handler;
+        LatencyHistogram total;
+        LatencyHistogram exchange;
+        std::atomic<int64_t> lastExchangeDelayNs{0};
+        std::atomic<uint64_t> negativeExchangeDelays{0};
+        std::atomic<int64_t> clockOffsetNs{0};
+        int64_t currentMin{INT64_MAX};
+        int64_t previousMin{INT64_MAX};
+        std::chrono::steady_clock::time_point windowStart{};
+    };
+    std::unique_ptr<LatencyRecorder> latency_;
+    std::string eventTimeKey_;
+    std::chrono::steady_clock::time_point rxStart_{};
+    std::chrono::steady_clock::time_point rxFramed_{};
+    std::chrono::system_clock::time_point rxWall_{};
+    
+    // permessage-deflate counters, written by the service thread
+    std::atomic<uint64_t> compressedBytes_{0};
+    std::atomic<uint64_t> decompressedBytes_{0};
+    std::atomic<int64_t> inflateNs_{0};
+    
+    // Liveness: ping in flight and the stream watchdog, service thread only
+    LoopTimer pingTimer_;
+    LoopTimer watchdogTimer_;
+    bool pingDue_{false};
+    bool pingOutstanding_{false};
+    uint64_t pingSeq_{0};
+    std::chrono::steady_clock::time_point pingSentAt_{};
+    std::function<void(const std::string&, std::chrono::milliseconds)> staleCallback_;
+    std::atomic<uint64_t> pingsSent_{0};
+    std::atomic<uint64_t> pongs_{0};
+    std::atomic<uint64_t> pongTimeouts_{0};
+    std::atomic<uint64_t> staleEvents_{0};
+    std::atomic<int64_t> lastRttNs_{0};
+    std::atomic<int64_t> minRttNs_{0};
+    std::atomic<int64_t> maxRttNs_{0};
+    std::atomic<int64_t> totalRttNs_{0};
+    
+    // Message delivery chosen by the handler; jsonDoc_ keeps its index
+    // storage across messages, arena_ is reset after every dispatch
+    ParseMode parseMode_{ParseMode::Dom};
+    JsonDoc jsonDoc_;
+    MessageArena arena_;
+    StreamRouter router_;
+    std::shared_ptr<RxPipeline> rxPipeline_;
+    // Messages of this client queued on rxPipeline_ or in its handlers
+    std::atomic<uint64_t> rxQueued_{0};
+    std::shared_ptr<FeedDeduplicator> dedup_;
+    std::shared_ptr<FrameRecorder> recorder_;
+    
     std::atomic<bool> running_{false};
-    std::thread serviceThread_;
-    std::thread subscribeThread_;
     
-    // Message queue
-    mutable std::mutex sendMutex_;
-    mutable std::queue<std::string> sendQueue_;
-    mutable std::condition_variable sendCv_;
+    // Outbound frames, written by senders and drained by the service thread
+    mutable SendRing sendRing_;
+    SendRing bulkRing_;
+    mutable std::atomic<bool> writeRequested_{false};
+    
+    // Rate limiter and lane accounting, service thread only (counters are
+    // read through sendStats())
+    struct LaneCounters {
+        std::atomic<uint64_t> sent{0};
+        std::atomic<int64_t> lastNs{0};
+        std::atomic<int64_t> maxNs{0};
+        std::atomic<int64_t> totalNs{0};
+    };
+    TokenBucket sendLimiter_;
+    double bulkReserve_;
+    LoopTimer throttleTimer_;
+    LaneCounters highLane_;
+    LaneCounters bulkLane_;
+    std::atomic<uint64_t> throttled_{0};
+    mutable std::atomic<bool> sendCongested_{false};
+    std::function<void(size_t, bool)> backpressureCallback_;
+    
+    // Subscribe management, service thread only: requests awaiting an ack
+    // keyed by request id, and the established subscriptions to restore after
+    // a reconnect. Any number of requests can be in flight at once.
+    std::unordered_map<uint64_t, SubscribeRequest> pendingSubs_;
+    std::unordered_map<std::string, SubscribeRequest> activeSubs_;
+    size_t keyMatchedPending_{0};
+    uint64_t nextLocalKey_{0};
+    LoopTimer subscribeTimer_;
+    bool everConnected_{false};
     
-    // Subscribe management
-    std::mutex subMutex_;
-    std::queue<SubscribeRequest> subscribeQueue_;
-    std::condition_variable subCv_;
+    // Guards the status maps, the stats and pendingCallbacks_, which are
+    // read from user threads
+    mutable std::mutex subMutex_;
+    SubscribeStats subscribeStats_;
     
     // Subscribe status tracking
     std::unordered_map<std::string, bool> subscribeStatus_;
@@ -120,11 +568,21 @@ private:
     std::function<void(const std::string&, bool)> unsubscriptionCallback_;
     std::vector<std::pair<std::string, bool>> pendingCallbacks_; // Tracks callbacks to be processed
 
+    friend class WsEventLoop;
+    friend class RxPipeline;
+    friend class FrameReplayer;
     friend int wsCallback(struct lws* wsi,
                          enum lws_callback_reasons reason,
                          void* user,
                          void* in,
                          size_t len);
+    friend int wsExtensionCallback(struct lws_context* context,
+                                   const struct lws_extension* ext,
+                                   struct lws* wsi,
+                                   enum lws_extension_callback_reasons reason,
+                                   void* user,
+                                   void* in,
+                                   size_t len);
 };
 
 } // namespace cexpp::util::wss
@@ -0,0 +1,168 @@
+// ws_event_loop.h
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+class WsClient;
+
+int wsCallback(struct lws* wsi,
+               enum lws_callback_reasons reason,
+               void* user,
+               void* in,
+               size_t len);
+
+// Wraps lws' permessage-deflate extension to account inflate work per client
+int wsExtensionCallback(struct lws_context* context,
+                        const struct lws_extension* ext,
+                        struct lws* wsi,
+                        enum lws_extension_callback_reasons reason,
+                        void* user,
+                        void* in,
+                        size_t len);
+
+// lws timer with a bound action; the lws callback gets the list node back
+// and finds its LoopTimer from it
+struct LoopTimer {
+    lws_sorted_usec_list_t sul{};
+    std::function<void()> fn;  // runs on the service thread
+
+    static void fire(lws_sorted_usec_list_t* sul) {
+        // std::function makes LoopTimer non-standard-layout; GCC and Clang
+        // still support offsetof on it, as it has no virtual bases
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+        lws_container_of(sul, LoopTimer, sul)->fn();
+#pragma GCC diagnostic pop
+    }
+};
+
+enum class LoopMode {
+    // Spin on lws_service() without ever sleeping in poll. Lowest latency,
+    // costs a full core; cross-thread work is picked up by polling a flag.
+    BusyPoll,
+    // Sleep in poll until socket activity, a timer, or a wake-up from
+    // lws_cancel_service() when another thread sends or posts work
+    Blocking
+};
+
+// permessage-deflate (RFC 7692) offer made by every connection of a loop
+struct DeflateConfig {
+    bool enabled{false};
+    // Largest LZ77 window (8..15) the server may compress with; smaller
+    // windows need less inflate memory per connection at some cost in ratio
+    int serverMaxWindowBits{15};
+    // Window we compress outbound frames with
+    int clientMaxWindowBits{15};
+    // Reset the compression context after every message: less memory per
+    // connection, but no cross-message dictionary
+    bool serverNoContextTakeover{false};
+    bool clientNoContextTakeover{false};
+};
+
+struct WsEventLoopConfig {
+    LoopMode mode{LoopMode::Blocking};
+    // Per-connection lws receive chunk size, larger frames arrive in pieces
+    size_t rxBufferSize{4096};
+    // Core the service thread is pinned to, -1 leaves it to the scheduler
+    int cpuCore{-1};
+    // Service thread name as shown by top/ps (at most 15 characters)
+    std::string name{"ws-loop"};
+    // Extensions are per lws_context: clients that want a different offer
+    // need a loop of their own
+    DeflateConfig deflate;
+};
+
+// Load counters of one loop. Written by the service thread only, readable
+// from anywhere.
+struct WsEventLoopStats {
+    size_t clients{0};
+    uint64_t rxMessages{0};
+    uint64_t rxBytes{0};
+    uint64_t txMessages{0};
+    int cpuCore{-1};
+};
+
+// One lws_context plus one service thread, shared by any number of WsClient
+// connections. Every lws call for the attached clients happens on the service
+// thread; other threads hand work over through post()/requestWritable(),
+// which wake the loop according to its LoopMode.
+class WsEventLoop {
+public:
+    explicit WsEventLoop(const WsEventLoopConfig& config = WsEventLoopConfig());
+    ~WsEventLoop();
+
+    WsEventLoop(const WsEventLoop&) = delete;
+    WsEventLoop& operator=(const WsEventLoop&) = delete;
+
+    struct lws_context* context() const { return context_; }
+    const char* protocolName() const { return protocols_[0].name; }
+    bool inServiceThread() const;
+
+    // Run task on the service thread at the next loop iteration
+    void post(std::function<void()> task);
+
+    // Ask for a WRITEABLE callback on client's connection, from any thread
+    void requestWritable(const WsClient* client);
+
+    // Timers, service thread only
+    void schedule(LoopTimer& timer, std::chrono::microseconds delay);
+    void cancel(LoopTimer& timer);
+
+    // Register a client with the loop. detach() closes its connection and
+    // returns once no more callbacks can reach the client.
+    void attach(WsClient* client);
+    void detach(WsClient* client);
+
+    size_t clientCount() const;
+    WsEventLoopStats stats() const;
+
+private:
+    void run();
+    void applyAffinity();
+    void wake();
+    void runPending();
+
+    WsEventLoopConfig config_;
+    struct lws_protocols protocols_[2];  // One for ws, one for null termination
+    struct lws_extension extensions_[2];  // permessage-deflate plus terminator
+    std::string deflateOffer_;
+    struct lws_context* context_{nullptr};
+
+    std::atomic<bool> running_{false};
+    std::thread serviceThread_;
+    std::atomic<std::thread::id> serviceThreadId_{};
+
+    // Cross-thread hand-over, drained on LWS_CALLBACK_EVENT_WAIT_CANCELLED
+    // (Blocking) or by the spinning loop once hasPending_ is set (BusyPoll)
+    std::atomic<bool> hasPending_{false};
+    std::mutex pendingMutex_;
+    std::vector<std::function<void()>> pendingTasks_;
+    std::vector<const WsClient*> pendingWrites_;
+
+    // Load counters, see WsEventLoopStats
+    std::atomic<uint64_t> rxMessages_{0};
+    std::atomic<uint64_t> rxBytes_{0};
+    std::atomic<uint64_t> txMessages_{0};
+
+    mutable std::mutex clientsMutex_;
+    std::vector<WsClient*> clients_;
+
+    friend class WsClient;
+    friend int wsCallback(struct lws* wsi,
+                          enum lws_callback_reasons reason,
+                          void* user,
+                          void* in,
+                          size_t len);
+};
+
+} // namespace cexpp::util::wss
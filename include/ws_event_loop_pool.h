@@ -0,0 +1,59 @@
+// ws_event_loop_pool.h
+
+#pragma once
+
+#include "ws_event_loop.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace cexpp::util::wss {
+
+enum class ShardPolicy {
+    RoundRobin,   // spread connections evenly in creation order
+    LeastLoaded,  // fewest clients, then fewest received messages
+    HashByKey     // same key (e.g. symbol) always lands on the same shard
+};
+
+// Custom shard selection: gets the assignment key and the current load of
+// every shard, returns a shard index
+using ShardSelector = std::function<size_t(std::string_view key,
+                                           const std::vector<WsEventLoopStats>& load)>;
+
+struct WsEventLoopPoolConfig {
+    // One shard per listed core, each service thread pinned to its core.
+    // When empty, `shards` unpinned loops are created.
+    std::vector<int> cores;
+    size_t shards{1};
+    ShardPolicy policy{ShardPolicy::RoundRobin};
+    // Overrides policy when set
+    ShardSelector selector;
+    // Template for every shard; cpuCore and name are filled in per shard
+    WsEventLoopConfig loop;
+};
+
+// N independent event loops (lws_context + service thread each). New
+// connections are spread over the shards via WsClientConfig::loop = pick(key).
+class WsEventLoopPool {
+public:
+    explicit WsEventLoopPool(const WsEventLoopPoolConfig& config);
+
+    // Shard for a new connection according to the configured policy
+    std::shared_ptr<WsEventLoop> pick(std::string_view key = {});
+
+    std::shared_ptr<WsEventLoop> shard(size_t index) const { return shards_.at(index); }
+    size_t size() const { return shards_.size(); }
+
+    std::vector<WsEventLoopStats> stats() const;
+
+private:
+    size_t select(std::string_view key);
+
+    WsEventLoopPoolConfig config_;
+    std::vector<std::shared_ptr<WsEventLoop>> shards_;
+    std::atomic<size_t> next_{0};
+};
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,182 @@
+// ws_log.h
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace cexpp::util::wss {
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error, Off };
+
+// One runtime level per category, each printed by an spdlog logger of the
+// category's name ("websocket", "websocket-loop", ...). Register a logger of
+// that name with spdlog before the first record to send it elsewhere.
+enum class LogCategory : uint8_t { Client, Loop, Rx, Capture, Redundant, Book, Dns, Count };
+
+// Any thread, takes effect on the next call. Records below the level cost
+// one relaxed atomic load at the call site; the default level is Info.
+void setLogLevel(LogCategory category, LogLevel level);
+LogLevel logLevel(LogCategory category);
+const char* logCategoryName(LogCategory category);
+
+// Block until everything queued so far has been written
+void flushLogs();
+// Records lost to a full queue (the caller never waits)
+uint64_t droppedLogRecords();
+
+namespace detail {
+
+// Formats a record's arguments into out, an spdlog::memory_buf_t
+using LogRenderFn = void (*)(const char* format, const unsigned char* args, void* out);
+
+// A fixed-size record in the log queue: the format string is a literal and
+// the arguments are copied in raw, so nothing is formatted or allocated on
+// the calling thread
+struct LogRecord {
+    static constexpr size_t argCapacity = 224;
+
+    std::atomic<uint64_t> seq{0};
+    std::chrono::system_clock::time_point time;
+    LogLevel level{LogLevel::Info};
+    LogCategory category{LogCategory::Client};
+    uint16_t argBytes{0};
+    const char* format{nullptr};
+    LogRenderFn render{nullptr};
+    unsigned char args[argCapacity];
+};
+
+extern std::atomic<uint8_t> logLevels[static_cast<size_t>(LogCategory::Count)];
+
+// Claim a free record, nullptr (and a drop counted) when the queue is full
+LogRecord* claimLogRecord();
+// Hand a claimed record to the writer thread
+void commitLogRecord(LogRecord* record);
+
+// Arguments are stored in order as arithmetic values or as length-prefixed
+// string bytes. A string is cut short when the record runs out of room, and
+// never takes the room reserved for the fixed-size arguments after it.
+template <typename T>
+constexpr bool isLogString = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+using LogStored = std::conditional_t<isLogString<T>, std::string_view, T>;
+
+template <typename T>
+constexpr size_t fixedLogBytes() {
+    if constexpr (isLogString<T>) {
+        return sizeof(uint16_t);
+    } else {
+        static_assert(std::is_arithmetic_v<T>, "log arguments must be arithmetic or strings");
+        return sizeof(T);
+    }
+}
+
+template <typename T>
+void packLogArg(unsigned char* args, size_t& used, size_t& reserved, const T& value) {
+    reserved -= fixedLogBytes<T>();
+    if constexpr (isLogString<T>) {
+        const std::string_view text(value);
+        const size_t room = LogRecord::argCapacity - used - reserved - sizeof(uint16_t);
+        const uint16_t len = static_cast<uint16_t>(std::min(text.size(), room));
+        std::memcpy(args + used, &len, sizeof(len));
+        std::memcpy(args + used + sizeof(len), text.data(), len);
+        used += sizeof(len) + len;
+    } else {
+        std::memcpy(args + used, &value, sizeof(T));
+        used += sizeof(T);
+    }
+}
+
+template <typename T>
+LogStored<T> unpackLogArg(const unsigned char* args, size_t& used) {
+    if constexpr (isLogString<T>) {
+        uint16_t len;
+        std::memcpy(&len, args + used, sizeof(len));
+        const std::string_view text(reinterpret_cast<const char*>(args + used + sizeof(len)), len);
+        used += sizeof(len) + len;
+        return text;
+    } else {
+        T value;
+        std::memcpy(&value, args + used, sizeof(T));
+        used += sizeof(T);
+        return value;
+    }
+}
+
+// Runs on the writer thread; a bad format string throws fmt::format_error
+template <typename... Args>
+void renderLogRecord(const char* format, [[maybe_unused]] const unsigned char* args, void* out) {
+    [[maybe_unused]] size_t used = 0;
+    // Braced initialisers are evaluated left to right
+    const std::tuple<LogStored<Args>...> values{unpackLogArg<Args>(args, used)...};
+    auto& buf = *static_cast<spdlog::memory_buf_t*>(out);
+    std::apply(
+        [&](const auto&... value) {
+            fmt::vformat_to(std::back_inserter(buf), fmt::string_view(format), fmt::make_format_args(value...));
+        },
+        values);
+}
+
+} // namespace detail
+
+// Asynchronous logger of one category. The calling thread checks the
+// category's level, copies the arguments into a queue record and goes on;
+// a background thread formats and writes. Arguments must be arithmetic or
+// convertible to std::string_view, and the format a string literal.
+class WsLogger {
+public:
+    constexpr explicit WsLogger(LogCategory category) : category_(category) {}
+
+    bool enabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >=
+               detail::logLevels[static_cast<size_t>(category_)].load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void debug(const char* format, const Args&... args) const { log(LogLevel::Debug, format, args...); }
+    template <typename... Args>
+    void info(const char* format, const Args&... args) const { log(LogLevel::Info, format, args...); }
+    template <typename... Args>
+    void warn(const char* format, const Args&... args) const { log(LogLevel::Warn, format, args...); }
+    template <typename... Args>
+    void error(const char* format, const Args&... args) const { log(LogLevel::Error, format, args...); }
+
+    template <typename... Args>
+    void log(LogLevel level, const char* format, const Args&... args) const {
+        constexpr size_t fixedBytes = (size_t{0} + ... + detail::fixedLogBytes<Args>());
+        static_assert(fixedBytes <= detail::LogRecord::argCapacity, "too many log arguments");
+        if (!enabled(level)) {
+            return;
+        }
+        detail::LogRecord* record = detail::claimLogRecord();
+        if (!record) {
+            return;
+        }
+        record->time = std::chrono::system_clock::now();
+        record->level = level;
+        record->category = category_;
+        record->format = format;
+        record->render = &detail::renderLogRecord<Args...>;
+        size_t used = 0;
+        [[maybe_unused]] size_t reserved = fixedBytes;
+        (void)std::initializer_list<int>{(detail::packLogArg(record->args, used, reserved, args), 0)...};
+        record->argBytes = static_cast<uint16_t>(used);
+        detail::commitLogRecord(record);
+    }
+
+private:
+    LogCategory category_;
+};
+
+} // namespace cexpp::util::wss
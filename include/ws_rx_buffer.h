@@ -0,0 +1,62 @@
+// ws_rx_buffer.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+namespace cexpp::util::wss {
+
+// Per-connection receive buffer used to reassemble fragmented frames.
+// The storage only ever grows and is reused across messages, so once it has
+// reached the size of the largest message seen there are no more allocations.
+class RxBuffer {
+public:
+    explicit RxBuffer(size_t initialCapacity = 64 * 1024) {
+        reserve(initialCapacity);
+    }
+
+    // Append one fragment. remainingHint is the number of bytes lws still
+    // expects for the current frame and is used to grow once instead of
+    // once per fragment.
+    void append(const void* data, size_t len, size_t remainingHint = 0) {
+        if (size_ + len + remainingHint > capacity_) {
+            reserve(size_ + len + remainingHint);
+        }
+        memcpy(data_.get() + size_, data, len);
+        size_ += len;
+    }
+
+    std::string_view view() const { return std::string_view(data_.get(), size_); }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    // Drop the current message but keep the storage
+    void clear() { size_ = 0; }
+
+private:
+    void reserve(size_t needed) {
+        if (needed <= capacity_) {
+            return;
+        }
+        size_t newCapacity = capacity_ ? capacity_ : 4096;
+        while (newCapacity < needed) {
+            newCapacity *= 2;
+        }
+        std::unique_ptr<char[]> grown(new char[newCapacity]);
+        if (size_) {
+            memcpy(grown.get(), data_.get(), size_);
+        }
+        data_ = std::move(grown);
+        capacity_ = newCapacity;
+    }
+
+    std::unique_ptr<char[]> data_;
+    size_t size_{0};
+    size_t capacity_{0};
+};
+
+} // namespace cexpp::util::wss
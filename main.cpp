@@ -1,4 +1,5 @@
 #include <ws_client.h>
+#include <typed_messages.h>
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -11,41 +12,33 @@ using namespace cexpp::util::wss;
 // Add global running flag
 static std::atomic<bool> running{true};
 
-class BinanceHandler : public IClientHandler {
+class BinanceHandler : public TypedDispatcher<Ticker> {
 public:
-    void onMessage(const nlohmann::json& json) override {
-        try {
-            // For a direct stream connection, we'll receive data directly
-            // The format is different from subscription-based connections
-            
-            // Direct stream data doesn't have a stream field, the whole JSON is the data
-            spdlog::info("Received market data: {}", json.dump(2));
-            
-            // Process ticker data specifically
-            if (json.contains("e") && json["e"] == "24hrTicker") {
-                // Example of extracting some key ticker data
-                std::string symbol = json["s"];
-                double price = std::stod(json["c"].get<std::string>());
-                double priceChange = std::stod(json["p"].get<std::string>());
-                double priceChangePercent = std::stod(json["P"].get<std::string>());
-                
-                spdlog::info("Ticker: {} Price: {} Change: {}%", 
-                             symbol, price, priceChangePercent);
-            }
-            
-            // Other message types can be processed here
-            
-            // Error handling still applies
-            if (json.contains("error")) {
-                spdlog::error("Error: {}", json.dump());
-            }
-        } catch (const std::exception& e) {
-            spdlog::error("Error processing message: {}", e.what());
-        }
+    BinanceHandler() {
+        // For a direct stream connection every frame is the ticker itself;
+        // fields are decoded straight from the frame, no DOM is built
+        on<Ticker>([](const Ticker& ticker) {
+            spdlog::info("Ticker: {} Price: {} Change: {}%",
+                         ticker.symbol, ticker.lastPrice, ticker.priceChangePercent);
+        });
     }
 
-    void onMessage(const std::string& msg) override {
-        spdlog::info("Received raw message: {}", msg);
+    bool onRawMessage(std::string_view msg) override {
+        if (onFrame(msg)) {
+            return true;
+        }
+        // Rejected or of no known type: keep it visible
+        bool error = false;
+        forEachMember(msg, [&error](std::string_view key, const RawValue&) {
+            error = key == "error";
+            return !error;
+        });
+        if (error) {
+            spdlog::error("Error: {}", msg);
+        } else {
+            spdlog::info("Received raw message: {}", msg);
+        }
+        return true;
     }
 
     void onUpdate() override {
@@ -67,6 +60,18 @@ public:
         return payload.dump();
     }
 
+    std::string genBatchSubscribePayload(const std::vector<std::string>& names, bool isUnsubscribe) override {
+        // Binance accepts many streams per frame: {"method":"SUBSCRIBE","params":["a","b"],"id":2}
+        static int requestId = 1000000;
+
+        nlohmann::json payload;
+        payload["method"] = isUnsubscribe ? "UNSUBSCRIBE" : "SUBSCRIBE";
+        payload["params"] = names;
+        payload["id"] = requestId++;
+
+        return payload.dump();
+    }
+
     void setWsClient(WsClient* client) {
         wsClient = client;
         // Don't start ping timer for direct streams
@@ -103,7 +108,7 @@ private:
 
 int main() {
     // Enable WebSocket logging
-    wsLogEnabled = true;
+    setWsLogEnabled(true);
     
     // Set spdlog to flush immediately to see real-time logs
     spdlog::set_level(spdlog::level::debug);
@@ -0,0 +1,115 @@
+// decimal.cpp
+#include <decimal.h>
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+namespace cexpp::util::wss {
+
+bool parseFixedPoint(std::string_view text, int decimals, int64_t& out) {
+    if (text.empty() || decimals < 0 || decimals > 18) {
+        return false;
+    }
+    size_t i = 0;
+    const bool negative = text[0] == '-';
+    if (negative) {
+        ++i;
+    }
+    constexpr uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    uint64_t value = 0;
+    int fraction = -1;  // digits read after the point, -1 before it
+    bool digits = false;
+    for (; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '.' && fraction < 0) {
+            fraction = 0;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        digits = true;
+        if (fraction >= decimals) {
+            // Below the resolution: only zeros are exact
+            if (c != '0') {
+                return false;
+            }
+            continue;
+        }
+        if (fraction >= 0) {
+            ++fraction;
+        }
+        const uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (value > (limit - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    if (!digits) {
+        return false;
+    }
+    for (int scale = std::max(fraction, 0); scale < decimals; ++scale) {
+        if (value > limit / 10) {
+            return false;
+        }
+        value *= 10;
+    }
+    out = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    return true;
+}
+
+bool parseDecimal(std::string_view text, double& out) {
+    static constexpr double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    // Integers up to 2^53 and powers of ten up to 1e22 are exact doubles,
+    // so one correctly rounded division gives the nearest double
+    constexpr uint64_t exactMantissa = uint64_t{1} << 53;
+
+    if (text.empty()) {
+        return false;
+    }
+    size_t i = text[0] == '-' ? 1 : 0;
+    uint64_t mantissa = 0;
+    int scale = -1;  // digits after the point, -1 before it
+    bool digits = false;
+    bool exact = true;
+    for (; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '.' && scale < 0) {
+            scale = 0;
+            continue;
+        }
+        if (c == 'e' || c == 'E') {
+            exact = false;
+            break;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        digits = true;
+        mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+        if (scale >= 0) {
+            ++scale;
+        }
+        if (mantissa > exactMantissa || scale > 22) {
+            exact = false;
+            break;
+        }
+    }
+    if (exact) {
+        if (!digits) {
+            return false;
+        }
+        const double value = static_cast<double>(mantissa) / powers[std::max(scale, 0)];
+        out = text[0] == '-' ? -value : value;
+        return true;
+    }
+
+    // Locale independent, unlike std::stod
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+} // namespace cexpp::util::wss
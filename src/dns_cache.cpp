@@ -0,0 +1,358 @@
+// dns_cache.cpp
+#include <dns_cache.h>
+#include <websocket_client_base.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Dns);
+
+// Numeric address and port as a socket address
+static bool toSockaddr(const std::string& address, uint16_t port, sockaddr_storage& out, socklen_t& len) {
+    std::memset(&out, 0, sizeof(out));
+    auto* v4 = reinterpret_cast<sockaddr_in*>(&out);
+    if (inet_pton(AF_INET, address.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        len = sizeof(sockaddr_in);
+        return true;
+    }
+    auto* v6 = reinterpret_cast<sockaddr_in6*>(&out);
+    if (inet_pton(AF_INET6, address.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        len = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+DnsCache::DnsCache(const DnsCacheConfig& config)
+    : config_(config) {
+    thread_ = std::thread([this]() { run(); });
+}
+
+DnsCache::~DnsCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    jobReady_.notify_all();
+    thread_.join();
+}
+
+std::shared_ptr<DnsCache> DnsCache::shared() {
+    static std::shared_ptr<DnsCache> cache = std::make_shared<DnsCache>();
+    return cache;
+}
+
+std::string DnsCache::key(const std::string& host, uint16_t port) {
+    return host + ":" + std::to_string(port);
+}
+
+DnsCache::Entry& DnsCache::entry(const std::string& host, uint16_t port) {
+    auto [it, inserted] = entries_.try_emplace(key(host, port));
+    if (inserted) {
+        it->second.host = host;
+        it->second.port = port;
+    }
+    return it->second;
+}
+
+void DnsCache::refresh(Entry& entry, std::chrono::steady_clock::time_point now) {
+    if (entry.resolving || now < entry.expires) {
+        return;
+    }
+    entry.resolving = true;
+    jobs_.push_back(key(entry.host, entry.port));
+    jobReady_.notify_one();
+}
+
+std::vector<const DnsCache::Endpoint*> DnsCache::ranked(const Entry& entry,
+                                                        std::chrono::steady_clock::time_point now) const {
+    // Group 0: measured, fastest first. 1: unmeasured. 2: recently failed.
+    auto group = [&](const Endpoint& e) {
+        if (e.failedAt != std::chrono::steady_clock::time_point{} && now - e.failedAt < config_.failurePenalty) {
+            return 2;
+        }
+        return e.stats.connectRtt.count() > 0 || e.stats.handshakeRtt.count() > 0 ? 0 : 1;
+    };
+    auto score = [](const Endpoint& e) {
+        return e.stats.connectRtt.count() > 0 ? e.stats.connectRtt : e.stats.handshakeRtt;
+    };
+
+    std::vector<const Endpoint*> order;
+    order.reserve(entry.endpoints.size());
+    for (const auto& e : entry.endpoints) {
+        order.push_back(&e);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const Endpoint* a, const Endpoint* b) {
+        const int ga = group(*a);
+        const int gb = group(*b);
+        if (ga != gb) {
+            return ga < gb;
+        }
+        return ga == 0 && score(*a) < score(*b);
+    });
+    return order;
+}
+
+DnsStatus DnsCache::lookup(const std::string& host, uint16_t port, std::vector<std::string>& addresses) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    Entry& e = entry(host, port);
+    refresh(e, now);
+
+    addresses.clear();
+    if (e.endpoints.empty()) {
+        return e.failed ? DnsStatus::Failed : DnsStatus::Pending;
+    }
+    for (const Endpoint* endpoint : ranked(e, now)) {
+        addresses.push_back(endpoint->stats.address);
+    }
+    return DnsStatus::Resolved;
+}
+
+std::vector<std::string> DnsCache::resolve(const std::string& host, uint16_t port, std::chrono::milliseconds timeout) {
+    std::vector<std::string> addresses;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Entry& e = entry(host, port);
+        refresh(e, std::chrono::steady_clock::now());
+        // Map references stay valid while other entries are added
+        resolveDone_.wait_for(lock, timeout, [&e]() { return !e.endpoints.empty() || !e.resolving; });
+    }
+    lookup(host, port, addresses);
+    return addresses;
+}
+
+void DnsCache::prefetch(const std::string& host, uint16_t port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refresh(entry(host, port), std::chrono::steady_clock::now());
+}
+
+DnsCache::Endpoint* DnsCache::find(const std::string& host, uint16_t port, const std::string& address) {
+    auto it = entries_.find(key(host, port));
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    for (auto& e : it->second.endpoints) {
+        if (e.stats.address == address) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+void DnsCache::smooth(std::chrono::nanoseconds& average, std::chrono::nanoseconds sample) const {
+    if (average.count() == 0) {
+        average = sample;
+        return;
+    }
+    const double w = std::clamp(config_.rttSmoothing, 0.0, 1.0);
+    average += std::chrono::nanoseconds(static_cast<int64_t>(w * static_cast<double>((sample - average).count())));
+    average = std::max(average, std::chrono::nanoseconds(1));
+}
+
+void DnsCache::recordHandshake(const std::string& host, uint16_t port, const std::string& address,
+                               std::chrono::nanoseconds rtt) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Endpoint* e = find(host, port, address)) {
+        smooth(e->stats.handshakeRtt, std::max(rtt, std::chrono::nanoseconds(1)));
+        e->stats.connects++;
+        e->failedAt = {};
+    }
+}
+
+void DnsCache::recordFailure(const std::string& host, uint16_t port, const std::string& address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Endpoint* e = find(host, port, address)) {
+        e->stats.failures++;
+        e->failedAt = std::chrono::steady_clock::now();
+    }
+}
+
+std::vector<EndpointStats> DnsCache::endpointStats(const std::string& host, uint16_t port) const {
+    std::vector<EndpointStats> stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key(host, port));
+    if (it == entries_.end()) {
+        return stats;
+    }
+    for (const Endpoint* e : ranked(it->second, std::chrono::steady_clock::now())) {
+        stats.push_back(e->stats);
+    }
+    return stats;
+}
+
+void DnsCache::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        jobReady_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+        if (stop_) {
+            return;
+        }
+        const std::string name = std::move(jobs_.front());
+        jobs_.pop_front();
+        const std::string host = entries_[name].host;
+        const uint16_t port = entries_[name].port;
+
+        lock.unlock();
+        std::vector<std::string> addresses;
+        const bool ok = resolveHost(host, port, addresses) && !addresses.empty();
+        lock.lock();
+
+        Entry& e = entries_[name];
+        const auto now = std::chrono::steady_clock::now();
+        e.resolving = false;
+        e.resolutions++;
+        if (ok) {
+            // Addresses still behind the name keep their measurements
+            std::vector<Endpoint> endpoints;
+            endpoints.reserve(addresses.size());
+            for (const auto& address : addresses) {
+                auto old = std::find_if(e.endpoints.begin(), e.endpoints.end(),
+                                        [&](const Endpoint& ep) { return ep.stats.address == address; });
+                if (old != e.endpoints.end()) {
+                    endpoints.push_back(std::move(*old));
+                } else {
+                    endpoints.emplace_back();
+                    endpoints.back().stats.address = address;
+                }
+            }
+            if (endpoints.size() != e.endpoints.size()) {
+                logger.info("{} resolves to {} addresses", host, endpoints.size());
+            }
+            e.endpoints = std::move(endpoints);
+            e.failed = false;
+            e.expires = now + config_.ttl;
+        } else {
+            // A failed refresh keeps serving the last good addresses
+            e.failed = e.endpoints.empty();
+            e.expires = now + config_.failedTtl;
+        }
+        resolveDone_.notify_all();
+
+        if (ok && config_.probe) {
+            lock.unlock();
+            probe(host, port, addresses);
+            lock.lock();
+        }
+    }
+}
+
+bool DnsCache::resolveHost(const std::string& host, uint16_t port, std::vector<std::string>& addresses) const {
+    if (config_.resolver) {
+        return config_.resolver(host, port, addresses);
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* result;
+    const int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+    if (rc != 0) {
+        logger.warn("Cannot resolve {}: {}", host, gai_strerror(rc));
+        return false;
+    }
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        char text[INET6_ADDRSTRLEN];
+        const void* addr = ai->ai_family == AF_INET6
+            ? static_cast<const void*>(&reinterpret_cast<sockaddr_in6*>(ai->ai_addr)->sin6_addr)
+            : static_cast<const void*>(&reinterpret_cast<sockaddr_in*>(ai->ai_addr)->sin_addr);
+        if (inet_ntop(ai->ai_family, addr, text, sizeof(text)) &&
+            std::find(addresses.begin(), addresses.end(), text) == addresses.end()) {
+            addresses.emplace_back(text);
+        }
+    }
+    freeaddrinfo(result);
+    return true;
+}
+
+void DnsCache::probe(const std::string& host, uint16_t port, const std::vector<std::string>& addresses) {
+    using namespace std::chrono;
+
+    // Non-blocking connects to all addresses at once, each timed from its
+    // own connect() to writability
+    const size_t n = addresses.size();
+    std::vector<pollfd> fds(n, pollfd{-1, POLLOUT, 0});
+    std::vector<steady_clock::time_point> started(n);
+    std::vector<nanoseconds> rtt(n, nanoseconds(-1));  // -1: failed
+    size_t pending = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sockaddr_storage addr;
+        socklen_t len;
+        if (!toSockaddr(addresses[i], port, addr, len)) {
+            continue;
+        }
+        const int fd = ::socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            continue;
+        }
+        started[i] = steady_clock::now();
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), len) == 0) {
+            rtt[i] = steady_clock::now() - started[i];
+            ::close(fd);
+        } else if (errno == EINPROGRESS) {
+            fds[i].fd = fd;
+            pending++;
+        } else {
+            ::close(fd);
+        }
+    }
+
+    const auto deadline = steady_clock::now() + config_.probeTimeout;
+    while (pending > 0) {
+        const auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if (left <= 0 || ::poll(fds.data(), fds.size(), static_cast<int>(left)) < 0) {
+            break;
+        }
+        const auto now = steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            if (fds[i].fd < 0 || !fds[i].revents) {
+                continue;
+            }
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+                rtt[i] = now - started[i];
+            }
+            ::close(fds[i].fd);
+            fds[i].fd = -1;
+            pending--;
+        }
+    }
+    for (auto& fd : fds) {
+        if (fd.fd >= 0) {
+            ::close(fd.fd);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = steady_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        Endpoint* e = find(host, port, addresses[i]);
+        if (!e) {
+            continue;
+        }
+        if (rtt[i].count() >= 0) {
+            smooth(e->stats.connectRtt, std::max(rtt[i], nanoseconds(1)));
+            logger.debug("{} probe {}: {} us", host, addresses[i], rtt[i].count() / 1000);
+        } else {
+            e->stats.failures++;
+            e->failedAt = now;
+            logger.debug("{} probe {}: failed", host, addresses[i]);
+        }
+    }
+}
+
+} // namespace cexpp::util::wss
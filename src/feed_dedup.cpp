@@ -0,0 +1,135 @@
+// feed_dedup.cpp
+#include <feed_dedup.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cexpp::util::wss {
+
+static uint64_t fnv1a(std::string_view data, uint64_t h = 14695981039346656037ULL) {
+    for (char c : data) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Unsigned value right after a "field": pattern, if it is a number
+static bool readUint(std::string_view json, size_t pos, uint64_t& value) {
+    while (pos < json.size() && json[pos] == ' ') {
+        ++pos;
+    }
+    if (pos >= json.size() || json[pos] < '0' || json[pos] > '9') {
+        return false;
+    }
+    value = 0;
+    while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
+        value = value * 10 + static_cast<uint64_t>(json[pos++] - '0');
+    }
+    return true;
+}
+
+FeedDeduplicator::FeedDeduplicator(size_t legs, const FeedDedupConfig& config)
+    : config_(config)
+    , legCount_(legs)
+    , counters_(std::make_unique<LegCounters[]>(legs)) {
+    if (legs == 0) {
+        throw std::invalid_argument("Deduplicator needs at least one leg");
+    }
+    config_.window = std::max<size_t>(config_.window, 1);
+    for (const auto& field : config_.idFields) {
+        idPatterns_.push_back("\"" + field + "\":");
+    }
+    if (!config_.eventTimeField.empty()) {
+        eventTimePattern_ = "\"" + config_.eventTimeField + "\":";
+    }
+}
+
+bool FeedDeduplicator::findId(std::string_view head, uint64_t& id) const {
+    for (const auto& pattern : idPatterns_) {
+        const size_t pos = head.find(pattern);
+        if (pos != std::string_view::npos && readUint(head, pos + pattern.size(), id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FeedDeduplicator::firstArrival(size_t leg, std::string_view key, std::string_view msg) {
+    LegCounters& counters = counters_[leg];
+
+    // Tag of the update, computed before taking the lock
+    const std::string_view head = msg.substr(0, config_.scanBytes);
+    uint64_t tag;
+    uint64_t id;
+    if (findId(head, id)) {
+        uint64_t eventTime = 0;
+        if (!eventTimePattern_.empty()) {
+            const size_t pos = head.find(eventTimePattern_);
+            if (pos != std::string_view::npos) {
+                readUint(head, pos + eventTimePattern_.size(), eventTime);
+            }
+        }
+        tag = id * 0x9E3779B97F4A7C15ULL ^ eventTime;
+    } else {
+        // Both legs receive byte-identical frames for the same event
+        tag = fnv1a(msg);
+        counters.hashed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const uint64_t streamHash = fnv1a(key);
+    Shard& shard = shards_[streamHash % SHARDS];
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Window& window = shard.streams[streamHash];
+        if (window.tags.empty()) {
+            window.tags.reserve(config_.window);
+        }
+
+        // Newest first: the losing leg usually trails by a message or two
+        const size_t count = window.tags.size();
+        for (size_t i = 0; i < count; ++i) {
+            const size_t slot = (window.next + count - 1 - i) % count;
+            if (window.tags[slot] == tag) {
+                first = false;
+                break;
+            }
+        }
+
+        if (first) {
+            if (count < config_.window) {
+                window.tags.push_back(tag);
+                window.next = 0;
+            } else {
+                window.tags[window.next] = tag;
+                window.next = (window.next + 1) % count;
+            }
+        }
+    }
+
+    if (first) {
+        counters.wins.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        counters.losses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return first;
+}
+
+std::vector<DedupLegStats> FeedDeduplicator::stats() const {
+    std::vector<DedupLegStats> result(legCount_);
+    for (size_t i = 0; i < legCount_; ++i) {
+        result[i].wins = counters_[i].wins.load(std::memory_order_relaxed);
+        result[i].losses = counters_[i].losses.load(std::memory_order_relaxed);
+        result[i].hashed = counters_[i].hashed.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void FeedDeduplicator::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.streams.clear();
+    }
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,210 @@
+// frame_capture.cpp
+#include <frame_capture.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Capture);
+
+static constexpr size_t paddedSize(size_t length) {
+    return (sizeof(FrameRecordHeader) + length + 7) & ~size_t{7};
+}
+
+FrameRecorder::FrameRecorder(const std::string& path, const FrameRecorderConfig& config)
+    : config_(config) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | (config.truncate ? O_TRUNC : 0), 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot open capture file " + path + ": " + std::strerror(errno));
+    }
+
+    // A new file gets a header, an existing one must be a capture already
+    struct stat st;
+    FrameFileHeader header{};
+    if (::fstat(fd_, &st) == 0 && st.st_size > 0) {
+        if (::pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header.magic, FRAME_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != FRAME_FILE_VERSION) {
+            ::close(fd_);
+            throw std::runtime_error("Not a frame capture file: " + path);
+        }
+    } else {
+        std::memcpy(header.magic, FRAME_FILE_MAGIC, sizeof(header.magic));
+        header.version = FRAME_FILE_VERSION;
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        writeAll(std::vector<char>(bytes, bytes + sizeof(header)));
+    }
+
+    active_.reserve(config_.bufferBytes);
+    pending_.reserve(config_.bufferBytes);
+    writer_ = std::thread([this]() { run(); });
+}
+
+FrameRecorder::~FrameRecorder() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    writerCv_.notify_one();
+    writer_.join();
+    ::close(fd_);
+}
+
+void FrameRecorder::record(uint32_t connection, std::string_view frame) {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record(connection, now, frame);
+}
+
+void FrameRecorder::record(uint32_t connection, int64_t timestampNs, std::string_view frame) {
+    FrameRecordHeader header;
+    header.timestampNs = timestampNs;
+    header.connection = connection;
+    header.length = static_cast<uint32_t>(frame.size());
+    const size_t size = paddedSize(frame.size());
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!active_.empty() && active_.size() + size > config_.bufferBytes) {
+        // Hand the full buffer over; only waits when the writer is still
+        // busy with the previous one
+        if (writing_) {
+            stalls_.fetch_add(1, std::memory_order_relaxed);
+            doneCv_.wait(lock, [this]() { return !writing_; });
+        }
+        active_.swap(pending_);
+        writing_ = true;
+        writerCv_.notify_one();
+    }
+
+    const char* bytes = reinterpret_cast<const char*>(&header);
+    active_.insert(active_.end(), bytes, bytes + sizeof(header));
+    active_.insert(active_.end(), frame.begin(), frame.end());
+    active_.resize(active_.size() + size - sizeof(header) - frame.size(), 0);
+    lock.unlock();
+
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(frame.size(), std::memory_order_relaxed);
+}
+
+void FrameRecorder::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [this]() { return !writing_; });
+    if (active_.empty()) {
+        return;
+    }
+    active_.swap(pending_);
+    writing_ = true;
+    writerCv_.notify_one();
+    doneCv_.wait(lock, [this]() { return !writing_; });
+}
+
+void FrameRecorder::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        writerCv_.wait(lock, [this]() { return writing_ || stopping_; });
+        if (!writing_) {
+            return;
+        }
+
+        // pending_ is ours until writing_ is cleared
+        lock.unlock();
+        writeAll(pending_);
+        pending_.clear();
+        writes_.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+
+        writing_ = false;
+        doneCv_.notify_all();
+    }
+}
+
+void FrameRecorder::writeAll(const std::vector<char>& buffer) {
+    size_t done = 0;
+    while (done < buffer.size()) {
+        const ssize_t n = ::write(fd_, buffer.data() + done, buffer.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger.error("Capture write failed: {}", std::strerror(errno));
+            return;
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+FrameRecorderStats FrameRecorder::stats() const {
+    FrameRecorderStats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.stalls = stalls_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+FrameReader::FrameReader(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open capture file " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a frame capture file: " + path);
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map capture file " + path + ": " + std::strerror(errno));
+    }
+    data_ = static_cast<const char*>(mapping);
+    // Replays walk the file front to back
+    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+
+    FrameFileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, FRAME_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FRAME_FILE_VERSION) {
+        ::munmap(mapping, size_);
+        throw std::runtime_error("Not a frame capture file: " + path);
+    }
+    offset_ = sizeof(FrameFileHeader);
+}
+
+FrameReader::~FrameReader() {
+    ::munmap(const_cast<char*>(data_), size_);
+}
+
+bool FrameReader::next(FrameRecord& record) {
+    if (size_ - offset_ < sizeof(FrameRecordHeader)) {
+        return false;
+    }
+    FrameRecordHeader header;
+    std::memcpy(&header, data_ + offset_, sizeof(header));
+    if (size_ - offset_ - sizeof(header) < header.length) {
+        return false;
+    }
+
+    record.timestampNs = header.timestampNs;
+    record.connection = header.connection;
+    record.data = std::string_view(data_ + offset_ + sizeof(header), header.length);
+    offset_ = std::min(size_, offset_ + paddedSize(header.length));
+    return true;
+}
+
+void FrameReader::rewind() {
+    offset_ = sizeof(FrameFileHeader);
+}
+
+} // namespace cexpp::util::wss
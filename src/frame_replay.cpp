@@ -0,0 +1,80 @@
+// frame_replay.cpp
+#include <frame_replay.h>
+#include <ws_client.h>
+#include <algorithm>
+#include <future>
+#include <thread>
+
+namespace cexpp::util::wss {
+
+FrameReplayer::FrameReplayer(const std::string& path)
+    : reader_(path) {}
+
+ReplayStats FrameReplayer::run(WsClient& client, const ReplayConfig& config) {
+    auto feed = [&client](const FrameRecord& record) { client.processMessage(record.data); };
+    if (client.loop_->inServiceThread()) {
+        return run(feed, config);
+    }
+
+    // processMessage belongs to the service thread; tasks posted before
+    // (addRoute, ...) run first
+    std::promise<ReplayStats> done;
+    client.loop_->post([&]() {
+        try {
+            done.set_value(run(feed, config));
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    });
+    return done.get_future().get();
+}
+
+ReplayStats FrameReplayer::run(const std::function<void(const FrameRecord&)>& sink,
+                               const ReplayConfig& config) {
+    using Clock = std::chrono::steady_clock;
+
+    reader_.rewind();
+    stopped_ = false;
+    const double speed = config.speed > 0 ? config.speed : 1.0;
+
+    ReplayStats stats;
+    FrameRecord record;
+    int64_t firstTimestamp = 0;
+    const auto start = Clock::now();
+    while (!stopped_ && reader_.next(record)) {
+        if (config.connection >= 0 && record.connection != static_cast<uint64_t>(config.connection)) {
+            continue;
+        }
+
+        if (config.pace == ReplayPace::Recorded) {
+            if (stats.frames == 0) {
+                firstTimestamp = record.timestampNs;
+            }
+            const auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(
+                static_cast<double>(record.timestampNs - firstTimestamp) / speed));
+            auto now = Clock::now();
+            if (due > now) {
+                // Sleep most of the gap, spin the rest for an accurate release
+                if (due - now > std::chrono::microseconds(200)) {
+                    std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+                }
+                while (Clock::now() < due) {
+                }
+            } else {
+                stats.maxLateness = std::max(stats.maxLateness,
+                                             std::chrono::duration_cast<std::chrono::nanoseconds>(now - due));
+            }
+        }
+
+        sink(record);
+        stats.frames++;
+        stats.bytes += record.data.size();
+        if (config.maxFrames && stats.frames >= config.maxFrames) {
+            break;
+        }
+    }
+    stats.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    return stats;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,465 @@
+// json_scanner.cpp
+#include <json_scanner.h>
+#include <charconv>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_SCANNER_X86 1
+#endif
+
+namespace cexpp::util::wss {
+
+namespace {
+
+// Per 64-byte block: one bit per byte
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;  // { } [ ] : ,
+};
+
+using MaskKernel = void (*)(const uint8_t* block, BlockMasks& masks);
+
+void masksScalar(const uint8_t* p, BlockMasks& m) {
+    m = {0, 0, 0};
+    for (int i = 0; i < 64; ++i) {
+        const uint8_t c = p[i];
+        const uint64_t bit = uint64_t{1} << i;
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        const uint8_t folded = c | 0x20;
+        if (c == '"') {
+            m.quote |= bit;
+        } else if (c == '\\') {
+            m.backslash |= bit;
+        } else if (folded == '{' || folded == '}' || c == ':' || c == ',') {
+            m.op |= bit;
+        }
+    }
+}
+
+#ifdef JSON_SCANNER_X86
+__attribute__((target("sse4.2")))
+void masksSse42(const uint8_t* p, BlockMasks& m) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lbrace = _mm_set1_epi8('{');
+    const __m128i rbrace = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i fold = _mm_set1_epi8(0x20);
+
+    m = {0, 0, 0};
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        const __m128i folded = _mm_or_si128(v, fold);
+        const __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, lbrace), _mm_cmpeq_epi8(folded, rbrace)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        const int shift = 16 * i;
+        m.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        m.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        m.op |= uint64_t(uint32_t(_mm_movemask_epi8(op))) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+void masksAvx2(const uint8_t* p, BlockMasks& m) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i lbrace = _mm256_set1_epi8('{');
+    const __m256i rbrace = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+
+    m = {0, 0, 0};
+    for (int i = 0; i < 2; ++i) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+        const __m256i folded = _mm256_or_si256(v, fold);
+        const __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, lbrace), _mm256_cmpeq_epi8(folded, rbrace)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        const int shift = 32 * i;
+        m.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+        m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+        m.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << shift;
+    }
+}
+#endif
+
+struct Kernel {
+    MaskKernel fn;
+    const char* name;
+};
+
+const Kernel& kernel() {
+    static const Kernel selected = []() -> Kernel {
+#ifdef JSON_SCANNER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {masksAvx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return {masksSse42, "sse4.2"};
+        }
+#endif
+        return {masksScalar, "scalar"};
+    }();
+    return selected;
+}
+
+// Bits of characters escaped by a preceding odd run of backslashes; carries
+// a run that ends on the last byte of the block into the next one
+uint64_t findEscaped(uint64_t backslash, uint64_t& prevEscaped) {
+    backslash &= ~prevEscaped;
+    const uint64_t followsEscape = (backslash << 1) | prevEscaped;
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    const uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+    uint64_t sequencesStartingOnEvenBits;
+    prevEscaped = __builtin_add_overflow(oddSequenceStarts, backslash, &sequencesStartingOnEvenBits);
+    const uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+    return (evenBits ^ invertMask) & followsEscape;
+}
+
+// Running xor: bit i set when an odd number of quotes precede or sit at i
+uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && isSpace(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && isSpace(s.back())) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool readHex4(std::string_view s, size_t pos, uint32_t& value) {
+    if (pos + 4 > s.size()) {
+        return false;
+    }
+    auto [ptr, ec] = std::from_chars(s.data() + pos, s.data() + pos + 4, value, 16);
+    return ec == std::errc() && ptr == s.data() + pos + 4;
+}
+
+} // namespace
+
+const char* JsonDoc::backend() {
+    return kernel().name;
+}
+
+bool JsonDoc::parse(std::string_view json) {
+    text_ = json;
+    index_.clear();
+
+    // Only an object or array is a document: root() starts at the first token
+    size_t first = 0;
+    while (first < json.size() && (json[first] == ' ' || json[first] == '\t' || json[first] == '\r' ||
+                                   json[first] == '\n')) {
+        ++first;
+    }
+    if (first == json.size() || (json[first] != '{' && json[first] != '[')) {
+        return false;
+    }
+
+    // Stage 1: structural characters, 64 bytes at a time
+    const MaskKernel masks = kernel().fn;
+    const auto* data = reinterpret_cast<const uint8_t*>(json.data());
+    const size_t size = json.size();
+    uint64_t prevEscaped = 0;
+    uint64_t prevInString = 0;
+
+    for (size_t base = 0; base < size; base += 64) {
+        const uint8_t* block = data + base;
+        uint8_t tail[64];
+        if (size - base < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, data + base, size - base);
+            block = tail;
+        }
+
+        BlockMasks m;
+        masks(block, m);
+
+        const uint64_t escaped = findEscaped(m.backslash, prevEscaped);
+        const uint64_t quotes = m.quote & ~escaped;
+        const uint64_t inString = prefixXor(quotes) ^ prevInString;
+        prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+        // Operators outside strings plus the opening quote of every string
+        uint64_t structural = (m.op & ~inString) | (quotes & inString);
+        while (structural) {
+            index_.push_back(static_cast<uint32_t>(base + __builtin_ctzll(structural)));
+            structural &= structural - 1;
+        }
+    }
+    if (prevInString) {
+        return false;
+    }
+
+    // Stage 2: pair up brackets so nested values can be skipped in O(1)
+    match_.resize(index_.size());
+    stack_.clear();
+    for (uint32_t i = 0; i < index_.size(); ++i) {
+        const char c = at(i);
+        if (c == '{' || c == '[') {
+            stack_.push_back(i);
+        } else if (c == '}' || c == ']') {
+            if (stack_.empty() || at(stack_.back()) != (c == '}' ? '{' : '[')) {
+                return false;
+            }
+            match_[stack_.back()] = i;
+            stack_.pop_back();
+        }
+    }
+    return stack_.empty();
+}
+
+JsonValue JsonDoc::root() const {
+    return valueFrom(0, 0);
+}
+
+JsonValue JsonDoc::valueFrom(uint32_t tok, size_t scalarBegin) const {
+    JsonValue v;
+    v.doc_ = this;
+
+    const uint32_t count = static_cast<uint32_t>(index_.size());
+    const char c = tok < count ? at(tok) : '\0';
+
+    if (c == '{' || c == '[') {
+        v.type_ = c == '{' ? JsonValue::Type::Object : JsonValue::Type::Array;
+        v.tok_ = tok;
+        v.after_ = match_[tok] + 1;
+        v.text_ = text_.substr(index_[tok], index_[match_[tok]] - index_[tok] + 1);
+        return v;
+    }
+
+    if (c == '"') {
+        // The closing quote is the last non-blank byte before the next token
+        size_t end = tok + 1 < count ? index_[tok + 1] : text_.size();
+        while (end > index_[tok] + 1 && isSpace(text_[end - 1])) {
+            --end;
+        }
+        if (end <= index_[tok] + 1 || text_[end - 1] != '"') {
+            return JsonValue();
+        }
+        v.type_ = JsonValue::Type::String;
+        v.tok_ = tok;
+        v.after_ = tok + 1;
+        v.text_ = text_.substr(index_[tok] + 1, end - 1 - index_[tok] - 1);
+        return v;
+    }
+
+    // Scalars are not indexed: they span up to the next token
+    const size_t end = tok < count ? index_[tok] : text_.size();
+    if (scalarBegin > end) {
+        return JsonValue();
+    }
+    const std::string_view text = trim(text_.substr(scalarBegin, end - scalarBegin));
+    if (text.empty()) {
+        return JsonValue();
+    }
+    switch (text.front()) {
+        case 't': v.type_ = JsonValue::Type::True; break;
+        case 'f': v.type_ = JsonValue::Type::False; break;
+        case 'n': v.type_ = JsonValue::Type::Null; break;
+        default: v.type_ = JsonValue::Type::Number; break;
+    }
+    v.tok_ = tok;
+    v.after_ = tok;
+    v.text_ = text;
+    return v;
+}
+
+JsonValue JsonDoc::member(uint32_t tok) const {
+    // "key" : value
+    const uint32_t count = static_cast<uint32_t>(index_.size());
+    if (tok + 1 >= count || at(tok) != '"' || at(tok + 1) != ':') {
+        return JsonValue();
+    }
+    size_t end = index_[tok + 1];
+    while (end > index_[tok] + 1 && isSpace(text_[end - 1])) {
+        --end;
+    }
+
+    JsonValue v = valueAfter(tok + 1);
+    v.key_ = text_.substr(index_[tok] + 1, end - 1 - index_[tok] - 1);
+    v.member_ = true;
+    return v;
+}
+
+JsonValue JsonValue::first() const {
+    if (type_ == Type::Object) {
+        if (doc_->at(tok_ + 1) == '}') {
+            return JsonValue();
+        }
+        return doc_->member(tok_ + 1);
+    }
+    if (type_ == Type::Array) {
+        return doc_->valueAfter(tok_);
+    }
+    return JsonValue();
+}
+
+JsonValue JsonValue::next() const {
+    if (after_ >= doc_->index_.size() || doc_->at(after_) != ',') {
+        return JsonValue();
+    }
+    return member_ ? doc_->member(after_ + 1) : doc_->valueAfter(after_);
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+    if (type_ != Type::Object) {
+        return JsonValue();
+    }
+    for (JsonValue v = first(); v.valid(); v = v.next()) {
+        if (v.key_ == key) {
+            return v;
+        }
+    }
+    return JsonValue();
+}
+
+JsonValue JsonValue::at(size_t index) const {
+    if (type_ != Type::Array) {
+        return JsonValue();
+    }
+    JsonValue v = first();
+    for (size_t i = 0; i < index && v.valid(); ++i) {
+        v = v.next();
+    }
+    return v;
+}
+
+bool JsonValue::get(std::string_view& out) const {
+    if (type_ != Type::String || text_.find('\\') != std::string_view::npos) {
+        return false;
+    }
+    out = text_;
+    return true;
+}
+
+bool JsonValue::get(std::string& out) const {
+    if (type_ != Type::String) {
+        return false;
+    }
+    out.clear();
+    for (size_t i = 0; i < text_.size(); ++i) {
+        const char c = text_[i];
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++i >= text_.size()) {
+            return false;
+        }
+        switch (text_[i]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!readHex4(text_, i + 1, cp)) {
+                    return false;
+                }
+                i += 4;
+                // Surrogate pair
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < text_.size() &&
+                    text_[i + 1] == '\\' && text_[i + 2] == 'u') {
+                    uint32_t low;
+                    if (readHex4(text_, i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool JsonValue::getNumberText(std::string_view& out) const {
+    if (type_ != Type::Number && type_ != Type::String) {
+        return false;
+    }
+    out = text_;
+    return !out.empty();
+}
+
+bool JsonValue::get(int64_t& out) const {
+    std::string_view s;
+    if (!getNumberText(s)) {
+        return false;
+    }
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+bool JsonValue::get(uint64_t& out) const {
+    std::string_view s;
+    if (!getNumberText(s)) {
+        return false;
+    }
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+bool JsonValue::get(double& out) const {
+    std::string_view s;
+    if (!getNumberText(s)) {
+        return false;
+    }
+    // Locale independent, unlike std::stod
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+bool JsonValue::get(bool& out) const {
+    if (type_ != Type::True && type_ != Type::False) {
+        return false;
+    }
+    out = type_ == Type::True;
+    return true;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,93 @@
+// latency_histogram.cpp
+#include <latency_histogram.h>
+#include <algorithm>
+#include <cmath>
+
+namespace cexpp::util::wss {
+
+static constexpr uint64_t SUB_BUCKETS = uint64_t{1} << LatencyHistogram::SUB_BUCKET_BITS;
+static constexpr uint64_t HALF_BUCKETS = SUB_BUCKETS / 2;
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(std::make_unique<std::atomic<uint64_t>[]>(BUCKETS)) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return static_cast<size_t>(ns);
+    }
+    // Keep the top SUB_BUCKET_BITS - 1 bits below the leading one
+    const int msb = 63 - __builtin_clzll(ns);
+    const int shift = msb - (SUB_BUCKET_BITS - 1);
+    const size_t index = SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + ((ns >> shift) - HALF_BUCKETS);
+    return std::min(index, BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    const size_t k = index - SUB_BUCKETS;
+    const int shift = static_cast<int>(k / HALF_BUCKETS) + 1;
+    return (HALF_BUCKETS + k % HALF_BUCKETS) << shift;
+}
+
+void LatencyHistogram::record(int64_t ns) {
+    const uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    counts_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t seen = min_.load(std::memory_order_relaxed);
+    while (value < seen && !min_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+    seen = max_.load(std::memory_order_relaxed);
+    while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.counts_.resize(BUCKETS);
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        snapshot.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+        count += snapshot.counts_[i];
+    }
+    // Summed from the buckets so percentiles stay consistent with count()
+    snapshot.count_ = count;
+    snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+    snapshot.min_ = count ? min_.load(std::memory_order_relaxed) : 0;
+    snapshot.max_ = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::chrono::nanoseconds HistogramSnapshot::mean() const {
+    return std::chrono::nanoseconds(count_ ? sum_ / count_ : 0);
+}
+
+std::chrono::nanoseconds HistogramSnapshot::percentile(double p) const {
+    if (!count_) {
+        return std::chrono::nanoseconds(0);
+    }
+    const double clamped = std::clamp(p, 0.0, 100.0);
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(count_))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            // Highest value the bucket stands for, but never beyond max()
+            const uint64_t upper = i + 1 < counts_.size() ? LatencyHistogram::bucketValue(i + 1) - 1
+                                                          : max_;
+            return std::chrono::nanoseconds(std::clamp(upper, min_, std::max(min_, max_)));
+        }
+    }
+    return std::chrono::nanoseconds(max_);
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,198 @@
+// msg_arena.cpp
+#include <msg_arena.h>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+namespace cexpp::util::wss {
+
+static thread_local MessageArena* currentArena = nullptr;
+
+void* MessageArena::CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    if (!upstream) {
+        owner->rebuild(std::max<size_t>(owner->capacity_, 1024));
+    }
+    allocations++;
+    this->bytes += bytes;
+    return upstream->allocate(bytes, alignment);
+}
+
+void MessageArena::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream->deallocate(p, bytes, alignment);
+}
+
+MessageArena::MessageArena(size_t initialBytes)
+    : capacity_(initialBytes) {
+    heap_.upstream = std::pmr::new_delete_resource();
+    front_.owner = this;
+}
+
+void MessageArena::rebuild(size_t capacity) {
+    // Destroying the old resource returns its overflow chunks to the heap
+    monotonic_.reset();
+    if (capacity != capacity_ || !block_) {
+        block_ = std::make_unique<std::byte[]>(capacity);
+        capacity_ = capacity;
+    }
+    monotonic_.emplace(block_.get(), capacity_, &heap_);
+    front_.upstream = &*monotonic_;
+    publishedCapacity_.store(capacity_, std::memory_order_relaxed);
+}
+
+std::pmr::memory_resource* MessageArena::resource() {
+    // The block is only allocated once something is allocated from it, so
+    // dispatches that decode nothing in the arena never touch it
+    return &front_;
+}
+
+void MessageArena::reset() {
+    if (!monotonic_ || !front_.allocations) {
+        messages_.store(messages_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t used = front_.bytes;
+    const uint64_t overflows = heap_.allocations;
+    messages_.store(messages_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    allocations_.store(allocations_.load(std::memory_order_relaxed) + front_.allocations,
+                       std::memory_order_relaxed);
+    bytes_.store(bytes_.load(std::memory_order_relaxed) + used, std::memory_order_relaxed);
+    heapAllocations_.store(heapAllocations_.load(std::memory_order_relaxed) + overflows,
+                           std::memory_order_relaxed);
+    if (used > peakBytes_.load(std::memory_order_relaxed)) {
+        peakBytes_.store(used, std::memory_order_relaxed);
+    }
+    front_.allocations = 0;
+    front_.bytes = 0;
+    heap_.allocations = 0;
+    heap_.bytes = 0;
+
+    if (overflows) {
+        // Outgrew the block: size it for this message plus alignment slack
+        size_t capacity = capacity_;
+        while (capacity < used + used / 4) {
+            capacity <<= 1;
+        }
+        rebuild(capacity);
+        return;
+    }
+    monotonic_->release();
+}
+
+MessageArenaStats MessageArena::stats() const {
+    MessageArenaStats stats;
+    stats.messages = messages_.load(std::memory_order_relaxed);
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.heapAllocations = heapAllocations_.load(std::memory_order_relaxed);
+    stats.capacity = publishedCapacity_.load(std::memory_order_relaxed);
+    stats.peakBytes = peakBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+MessageArena* MessageArena::current() {
+    return currentArena;
+}
+
+ArenaScope::ArenaScope(MessageArena& arena)
+    : arena_(arena)
+    , previous_(detail::currentArenaResource())
+    , previousArena_(currentArena) {
+    detail::currentArenaResource() = arena.resource();
+    currentArena = &arena;
+}
+
+ArenaScope::~ArenaScope() {
+    detail::currentArenaResource() = previous_;
+    currentArena = previousArena_;
+    arena_.reset();
+}
+
+static void build(const JsonValue& value, ArenaJson& out) {
+    switch (value.type()) {
+        case JsonValue::Type::Object: {
+            out = ArenaJson::object();
+            auto& object = out.get_ref<ArenaJson::object_t&>();
+            value.forEachField([&](std::string_view key, JsonValue field) {
+                build(field, object[ArenaString(key)]);
+            });
+            return;
+        }
+
+        case JsonValue::Type::Array: {
+            out = ArenaJson::array();
+            auto& array = out.get_ref<ArenaJson::array_t&>();
+            value.forEachElement([&](JsonValue element) {
+                array.emplace_back();
+                build(element, array.back());
+            });
+            return;
+        }
+
+        case JsonValue::Type::String: {
+            std::string_view text;
+            if (value.get(text)) {
+                out = ArenaString(text);
+                return;
+            }
+            // Escaped strings are rare in market data, unescape via the heap
+            std::string unescaped;
+            value.get(unescaped);
+            out = ArenaString(unescaped);
+            return;
+        }
+
+        case JsonValue::Type::Number: {
+            // Same number_integer/unsigned/float split as nlohmann's parser
+            const std::string_view text = value.raw();
+            if (text.find_first_of(".eE") == std::string_view::npos) {
+                if (text[0] == '-') {
+                    int64_t number;
+                    if (value.get(number)) {
+                        out = number;
+                        return;
+                    }
+                } else {
+                    uint64_t number;
+                    if (value.get(number)) {
+                        out = number;
+                        return;
+                    }
+                }
+            }
+            double number = 0;
+            value.get(number);
+            out = number;
+            return;
+        }
+
+        case JsonValue::Type::True:
+            out = true;
+            return;
+
+        case JsonValue::Type::False:
+            out = false;
+            return;
+
+        case JsonValue::Type::Null:
+        case JsonValue::Type::Invalid:
+            out = nullptr;
+            return;
+    }
+}
+
+const ArenaJson& buildArenaJson(const JsonValue& value) {
+    MessageArena* arena = MessageArena::current();
+    if (!arena) {
+        throw std::runtime_error("buildArenaJson outside of an ArenaScope");
+    }
+    
+    // Never destroyed: nlohmann's destructor allocates a heap stack to tear
+    // containers down, and the arena reset releases everything anyway
+    void* storage = arena->resource()->allocate(sizeof(ArenaJson), alignof(ArenaJson));
+    auto* root = new (storage) ArenaJson();
+    build(value, *root);
+    return *root;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,377 @@
+// order_book.cpp
+#include <order_book.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Book);
+
+std::vector<BookLadder::Level>::iterator BookLadder::find(int64_t key) {
+    // Most updates land near the top: walk a few levels back from the best
+    // before falling back to a binary search
+    auto it = levels_.end();
+    for (int i = 0; i < 8 && it != levels_.begin(); ++i) {
+        auto prev = it - 1;
+        if (prev->key < key) {
+            return it;
+        }
+        it = prev;
+    }
+    return std::lower_bound(levels_.begin(), it, key,
+                            [](const Level& level, int64_t k) { return level.key < k; });
+}
+
+bool BookLadder::apply(int64_t price, int64_t quantity, size_t maxLevels) {
+    const int64_t key = keyOf(price);
+    auto it = find(key);
+    const bool found = it != levels_.end() && it->key == key;
+    if (quantity == 0) {
+        if (found) {
+            levels_.erase(it);
+        }
+        return found;
+    }
+    if (found) {
+        it->quantity = quantity;
+        return true;
+    }
+    levels_.insert(it, Level{key, quantity});
+    if (levels_.size() > maxLevels) {
+        levels_.erase(levels_.begin());
+    }
+    return true;
+}
+
+int64_t BookLadder::quantityAt(int64_t price) const {
+    const int64_t key = keyOf(price);
+    auto it = std::lower_bound(levels_.begin(), levels_.end(), key,
+                               [](const Level& level, int64_t k) { return level.key < k; });
+    return it != levels_.end() && it->key == key ? it->quantity : 0;
+}
+
+static bool readLevels(JsonValue array, int priceDecimals, int quantityDecimals, std::vector<PriceLevel>& out) {
+    if (!array.isArray()) {
+        return false;
+    }
+    bool ok = true;
+    array.forEachElement([&](JsonValue entry) {
+        const JsonValue price = entry.at(0);
+        const JsonValue quantity = entry.at(1);
+        PriceLevel level;
+        if (!ok || !(price.isString() || price.isNumber()) || !(quantity.isString() || quantity.isNumber()) ||
+            !parseFixedPoint(price.raw(), priceDecimals, level.price) ||
+            !parseFixedPoint(quantity.raw(), quantityDecimals, level.quantity)) {
+            ok = false;
+            return;
+        }
+        out.push_back(level);
+    });
+    return ok;
+}
+
+bool FileSnapshotSource::parse(std::string_view json, int priceDecimals, int quantityDecimals, DepthSnapshot& out) {
+    JsonDoc doc;
+    if (!doc.parse(json) || !doc["lastUpdateId"].get(out.lastUpdateId)) {
+        return false;
+    }
+    out.bids.clear();
+    out.asks.clear();
+    return readLevels(doc["bids"], priceDecimals, quantityDecimals, out.bids) &&
+           readLevels(doc["asks"], priceDecimals, quantityDecimals, out.asks);
+}
+
+void FileSnapshotSource::fetch(const std::string& symbol, int priceDecimals, int quantityDecimals, DoneFn done) {
+    std::string path = path_;
+    for (size_t pos = path.find("{symbol}"); pos != std::string::npos; pos = path.find("{symbol}", pos)) {
+        path.replace(pos, 8, symbol);
+        pos += symbol.size();
+    }
+
+    DepthSnapshot snapshot;
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const bool ok = file.good() && parse(contents.str(), priceDecimals, quantityDecimals, snapshot);
+    if (!ok) {
+        logger.error("Cannot read depth snapshot from {}", path);
+    }
+    done(ok, std::move(snapshot));
+}
+
+static double powerOf10(int exponent) {
+    double scale = 1.0;
+    for (int i = 0; i < exponent; ++i) {
+        scale *= 10.0;
+    }
+    return scale;
+}
+
+OrderBookSync::OrderBookSync(const OrderBookConfig& config, std::shared_ptr<ISnapshotSource> source)
+    : config_(config)
+    , source_(std::move(source))
+    , priceScale_(powerOf10(config.priceDecimals))
+    , quantityScale_(powerOf10(config.quantityDecimals)) {
+    if (!source_) {
+        throw std::invalid_argument("Order book needs a snapshot source");
+    }
+    if (config_.priceDecimals < 0 || config_.priceDecimals > 18 ||
+        config_.quantityDecimals < 0 || config_.quantityDecimals > 18) {
+        throw std::invalid_argument("Order book decimals must be within 0..18");
+    }
+    config_.maxLevels = std::max<size_t>(config_.maxLevels, 1);
+    config_.maxBufferedDiffs = std::max<size_t>(config_.maxBufferedDiffs, 1);
+}
+
+void OrderBookSync::onDocument(const JsonDoc& doc) {
+    const JsonValue root = doc.root();
+    const JsonValue data = root["data"];
+    if (!decode(data ? data : root, scratch_)) {
+        counters_.rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    onDiff(scratch_);
+}
+
+bool OrderBookSync::onDepthMessage(std::string_view msg) {
+    if (!doc_.parse(msg)) {
+        counters_.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const JsonValue root = doc_.root();
+    const JsonValue data = root["data"];
+    if (!decode(data ? data : root, scratch_)) {
+        counters_.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    onDiff(scratch_);
+    return true;
+}
+
+bool OrderBookSync::decode(JsonValue data, Diff& diff) const {
+    diff.bids.clear();
+    diff.asks.clear();
+    if (!data["U"].get(diff.first) || !data["u"].get(diff.last)) {
+        return false;
+    }
+    diff.hasPrevious = data["pu"].get(diff.previous);
+    return readLevels(data["b"], config_.priceDecimals, config_.quantityDecimals, diff.bids) &&
+           readLevels(data["a"], config_.priceDecimals, config_.quantityDecimals, diff.asks);
+}
+
+void OrderBookSync::onDiff(Diff& diff) {
+    if (snapshotReady_.load(std::memory_order_acquire)) {
+        takeSnapshot();
+    }
+    if (state_.load(std::memory_order_relaxed) == BookState::Live) {
+        live(diff);
+    } else {
+        buffer(diff);
+        requestSnapshot();
+    }
+    // Synchronous sources have answered by now
+    if (snapshotReady_.load(std::memory_order_acquire)) {
+        takeSnapshot();
+    }
+}
+
+void OrderBookSync::live(Diff& diff) {
+    if (diff.last <= lastUpdateId_) {
+        counters_.stale.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // The first diff after a snapshot only has to straddle it. Futures ids
+    // are not consecutive, so there the first diff may also start past the
+    // snapshot as long as pu links it.
+    bool follows;
+    if (awaitingFirst_ && diff.hasPrevious) {
+        follows = diff.first <= lastUpdateId_ || diff.previous == lastUpdateId_;
+    } else if (awaitingFirst_) {
+        follows = diff.first <= lastUpdateId_ + 1;
+    } else if (diff.hasPrevious) {
+        follows = diff.previous == lastUpdateId_;
+    } else {
+        follows = diff.first == lastUpdateId_ + 1;
+    }
+    if (follows) {
+        apply(diff);
+        return;
+    }
+
+    counters_.gaps.fetch_add(1, std::memory_order_relaxed);
+    logger.warn("{} depth gap: book at {}, diff {}..{}, resyncing",
+                 config_.symbol, lastUpdateId_, diff.first, diff.last);
+    // The snapshot is older than the diffs after it. Asked again right away,
+    // the server would most likely return the same one.
+    if (awaitingFirst_) {
+        nextSnapshot_ = std::chrono::steady_clock::now() + config_.snapshotRetry;
+    }
+    resync();
+    buffer(diff);
+    requestSnapshot();
+}
+
+void OrderBookSync::apply(const Diff& diff) {
+    for (const auto& level : diff.bids) {
+        bids_.apply(level.price, level.quantity, config_.maxLevels);
+    }
+    for (const auto& level : diff.asks) {
+        asks_.apply(level.price, level.quantity, config_.maxLevels);
+    }
+    lastUpdateId_ = diff.last;
+    awaitingFirst_ = false;
+    counters_.diffs.fetch_add(1, std::memory_order_relaxed);
+    counters_.levels.fetch_add(diff.bids.size() + diff.asks.size(), std::memory_order_relaxed);
+    publishTop();
+    if (updateFn_) {
+        updateFn_(*this);
+    }
+}
+
+void OrderBookSync::buffer(Diff& diff) {
+    if (buffered_.size() >= config_.maxBufferedDiffs) {
+        spare_.push_back(std::move(buffered_.front()));
+        buffered_.erase(buffered_.begin());
+    }
+    Diff slot;
+    if (!spare_.empty()) {
+        slot = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    // The diff's levels move into the buffer; it gets the slot's capacity
+    std::swap(slot, diff);
+    buffered_.push_back(std::move(slot));
+    counters_.buffered.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OrderBookSync::requestSnapshot() {
+    if (snapshotPending_ || std::chrono::steady_clock::now() < nextSnapshot_) {
+        return;
+    }
+    snapshotPending_ = true;
+    counters_.snapshots.fetch_add(1, std::memory_order_relaxed);
+    source_->fetch(config_.symbol, config_.priceDecimals, config_.quantityDecimals,
+                   [this](bool ok, DepthSnapshot&& snapshot) { onSnapshot(ok, std::move(snapshot)); });
+}
+
+void OrderBookSync::onSnapshot(bool ok, DepthSnapshot&& snapshot) {
+    std::lock_guard<std::mutex> lock(snapshotMutex_);
+    snapshot_ = std::move(snapshot);
+    snapshotOk_ = ok;
+    snapshotReady_.store(true, std::memory_order_release);
+}
+
+void OrderBookSync::takeSnapshot() {
+    DepthSnapshot snapshot;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex_);
+        snapshot = std::move(snapshot_);
+        ok = snapshotOk_;
+        snapshotReady_.store(false, std::memory_order_relaxed);
+    }
+    snapshotPending_ = false;
+    if (!ok) {
+        nextSnapshot_ = std::chrono::steady_clock::now() + config_.snapshotRetry;
+        return;
+    }
+    if (state_.load(std::memory_order_relaxed) == BookState::Live) {
+        return;
+    }
+    loadSnapshot(snapshot);
+}
+
+void OrderBookSync::loadSnapshot(DepthSnapshot& snapshot) {
+    bids_.clear();
+    asks_.clear();
+    for (const auto& level : snapshot.bids) {
+        bids_.apply(level.price, level.quantity, config_.maxLevels);
+    }
+    for (const auto& level : snapshot.asks) {
+        asks_.apply(level.price, level.quantity, config_.maxLevels);
+    }
+    lastUpdateId_ = snapshot.lastUpdateId;
+    awaitingFirst_ = true;
+    state_.store(BookState::Live, std::memory_order_release);
+    logger.info("{} book loaded at {}, replaying {} buffered diffs",
+                 config_.symbol, lastUpdateId_, buffered_.size());
+
+    // Replay through the live path: diffs the snapshot covers are skipped,
+    // and a snapshot older than the buffer shows up as a gap
+    std::vector<Diff> pending;
+    pending.swap(buffered_);
+    for (auto& diff : pending) {
+        if (state_.load(std::memory_order_relaxed) == BookState::Live) {
+            live(diff);
+        } else {
+            buffer(diff);
+        }
+    }
+    for (auto& diff : pending) {
+        spare_.push_back(std::move(diff));
+    }
+    if (state_.load(std::memory_order_relaxed) == BookState::Live) {
+        publishTop();
+        if (updateFn_) {
+            updateFn_(*this);
+        }
+    }
+}
+
+void OrderBookSync::resync() {
+    state_.store(BookState::Syncing, std::memory_order_release);
+    bids_.clear();
+    asks_.clear();
+    awaitingFirst_ = false;
+    publishTop();
+}
+
+void OrderBookSync::publishTop() {
+    const PriceLevel bid = bids_.best();
+    const PriceLevel ask = asks_.best();
+    const uint64_t updateId = state_.load(std::memory_order_relaxed) == BookState::Live ? lastUpdateId_ : 0;
+
+    const uint64_t seq = topSeq_.load(std::memory_order_relaxed);
+    topSeq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    topBidPrice_.store(bid.price, std::memory_order_relaxed);
+    topBidQuantity_.store(bid.quantity, std::memory_order_relaxed);
+    topAskPrice_.store(ask.price, std::memory_order_relaxed);
+    topAskQuantity_.store(ask.quantity, std::memory_order_relaxed);
+    topUpdateId_.store(updateId, std::memory_order_relaxed);
+    topSeq_.store(seq + 2, std::memory_order_release);
+}
+
+TopOfBook OrderBookSync::top() const {
+    TopOfBook top;
+    for (;;) {
+        const uint64_t before = topSeq_.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        top.bid = {topBidPrice_.load(std::memory_order_relaxed), topBidQuantity_.load(std::memory_order_relaxed)};
+        top.ask = {topAskPrice_.load(std::memory_order_relaxed), topAskQuantity_.load(std::memory_order_relaxed)};
+        top.updateId = topUpdateId_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (topSeq_.load(std::memory_order_relaxed) == before) {
+            return top;
+        }
+    }
+}
+
+OrderBookStats OrderBookSync::stats() const {
+    OrderBookStats stats;
+    stats.diffs = counters_.diffs.load(std::memory_order_relaxed);
+    stats.levels = counters_.levels.load(std::memory_order_relaxed);
+    stats.buffered = counters_.buffered.load(std::memory_order_relaxed);
+    stats.stale = counters_.stale.load(std::memory_order_relaxed);
+    stats.gaps = counters_.gaps.load(std::memory_order_relaxed);
+    stats.snapshots = counters_.snapshots.load(std::memory_order_relaxed);
+    stats.rejected = counters_.rejected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,157 @@
+// redundant_client.cpp
+#include <redundant_client.h>
+#include <algorithm>
+#include <stdexcept>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Redundant);
+
+RedundantWsClient::RedundantWsClient(IClientHandler* handler,
+                                     std::string_view url,
+                                     std::string_view path,
+                                     uint16_t port,
+                                     bool useSSL,
+                                     const RedundantClientConfig& config)
+    : ClientBase(handler)
+    , dedup_(std::make_shared<FeedDeduplicator>(config.legs, config.dedup)) {
+    // Without an explicit loop the legs share one, so the handler is only
+    // ever called from one thread
+    std::shared_ptr<WsEventLoop> sharedLoop = config.leg.loop;
+    if (!sharedLoop && config.loops.empty()) {
+        sharedLoop = std::make_shared<WsEventLoop>(config.leg.loopConfig);
+    }
+
+    logger.info("{} legs to {}:{}{}", config.legs, url, port, config.spreadAddresses ? ", spread over its addresses" : "");
+    legs_.reserve(config.legs);
+    for (size_t i = 0; i < config.legs; ++i) {
+        WsClientConfig legConfig = config.leg;
+        legConfig.loop = config.loops.empty() ? sharedLoop : config.loops[i % config.loops.size()];
+        legConfig.dedup = dedup_;
+        legConfig.dedupLeg = i;
+        // Leg i starts at the i-th fastest address, so the first legs get
+        // the best routes. Each leg looks the addresses up when it connects,
+        // the cache resolves them in the background until then.
+        if (config.spreadAddresses) {
+            legConfig.addressOffset = i;
+        }
+        legs_.push_back(std::make_shared<WsClient>(handler, url, path, port, useSSL, legConfig));
+    }
+}
+
+void RedundantWsClient::reconnect(std::string_view reason) {
+    for (auto& leg : legs_) {
+        leg->reconnect(reason);
+    }
+}
+
+void RedundantWsClient::send(std::string_view payload) const {
+    for (const auto& leg : legs_) {
+        if (leg->connectionState() == ConnectionState::Connected) {
+            leg->send(payload);
+            return;
+        }
+    }
+    // Nothing is up: queue on the first leg, it goes out once it connects
+    legs_.front()->send(payload);
+}
+
+void RedundantWsClient::subscribe(std::string_view name,
+                                  std::string_view payload,
+                                  std::string_view successKey,
+                                  bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->subscribe(name, payload, successKey, waitOk);
+    }
+}
+
+void RedundantWsClient::unSubscribe(std::string_view name,
+                                    std::string_view payload,
+                                    std::string_view successKey,
+                                    bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->unSubscribe(name, payload, successKey, waitOk);
+    }
+}
+
+void RedundantWsClient::subscribeDynamic(std::string_view name,
+                                         std::string_view successKey,
+                                         bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->subscribeDynamic(name, successKey, waitOk);
+    }
+}
+
+void RedundantWsClient::unSubscribeDynamic(std::string_view name,
+                                           std::string_view successKey,
+                                           bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->unSubscribeDynamic(name, successKey, waitOk);
+    }
+}
+
+void RedundantWsClient::subscribeMany(const std::vector<std::string>& names,
+                                      std::string_view successKey,
+                                      bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->subscribeMany(names, successKey, waitOk);
+    }
+}
+
+void RedundantWsClient::unSubscribeMany(const std::vector<std::string>& names,
+                                        std::string_view successKey,
+                                        bool waitOk) {
+    for (auto& leg : legs_) {
+        leg->unSubscribeMany(names, successKey, waitOk);
+    }
+}
+
+bool RedundantWsClient::isSubscribeOk(std::string_view name) {
+    for (auto& leg : legs_) {
+        if (leg->isSubscribeOk(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RedundantWsClient::isUnsubscribeOk(std::string_view name) {
+    for (auto& leg : legs_) {
+        if (!leg->isUnsubscribeOk(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RedundantWsClient::addRoute(std::string_view channel, IClientHandler* channelHandler) {
+    for (auto& leg : legs_) {
+        leg->addRoute(channel, channelHandler);
+    }
+}
+
+void RedundantWsClient::removeRoute(std::string_view channel) {
+    for (auto& leg : legs_) {
+        leg->removeRoute(channel);
+    }
+}
+
+size_t RedundantWsClient::legsUp() const {
+    return static_cast<size_t>(std::count_if(legs_.begin(), legs_.end(), [](const auto& leg) {
+        return leg->connectionState() == ConnectionState::Connected;
+    }));
+}
+
+std::vector<RedundantLegStats> RedundantWsClient::legStats() const {
+    const std::vector<DedupLegStats> dedup = dedup_->stats();
+    std::vector<RedundantLegStats> result(legs_.size());
+    for (size_t i = 0; i < legs_.size(); ++i) {
+        result[i].address = legs_[i]->reconnectStats().address;
+        result[i].state = legs_[i]->connectionState();
+        result[i].dedup = dedup[i];
+    }
+    return result;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,305 @@
+// rx_pipeline.cpp
+#include <rx_pipeline.h>
+#include <ws_client.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <pthread.h>
+#include <sched.h>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Rx);
+
+// Pipeline whose consumer runs on this thread, for flush()
+static thread_local const RxPipeline* currentPipeline = nullptr;
+
+RxPipeline::Ring::Ring(size_t slots, size_t slotBytes) {
+    size_t capacity = 1;
+    while (capacity < slots) {
+        capacity <<= 1;
+    }
+    mask_ = capacity - 1;
+    slots_ = std::make_unique<Slot[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+        slots_[i].buf.resize(slotBytes);
+    }
+}
+
+RxPipeline::Slot* RxPipeline::Ring::claimPush(uint64_t& pos) {
+    pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &slots_[pos & mask_];
+        const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        const int64_t dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (dif == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return slot;
+            }
+        } else if (dif < 0) {
+            return nullptr;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+RxPipeline::Slot* RxPipeline::Ring::claimPop(uint64_t& pos) {
+    pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &slots_[pos & mask_];
+        const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        const int64_t dif = static_cast<int64_t>(seq) - static_cast<int64_t>(pos + 1);
+        if (dif == 0) {
+            if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return slot;
+            }
+        } else if (dif < 0) {
+            return nullptr;
+        } else {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t RxPipeline::Ring::size() const {
+    const uint64_t head = enqueuePos_.load(std::memory_order_relaxed);
+    const uint64_t tail = dequeuePos_.load(std::memory_order_acquire);
+    return head > tail ? static_cast<size_t>(head - tail) : 0;
+}
+
+RxPipeline::RxPipeline(const RxPipelineConfig& config)
+    : config_(config) {
+    if (config_.consumerCores.empty()) {
+        throw std::runtime_error("RxPipeline needs at least one consumer");
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < config_.consumerCores.size(); ++i) {
+        auto consumer = std::make_unique<Consumer>(config_.slots, config_.slotBytes, config_.arenaBytes);
+        consumer->core = config_.consumerCores[i];
+        consumers_.push_back(std::move(consumer));
+    }
+    for (size_t i = 0; i < consumers_.size(); ++i) {
+        Consumer& consumer = *consumers_[i];
+        consumer.thread = std::thread([this, &consumer, i]() { run(consumer, i); });
+    }
+}
+
+RxPipeline::~RxPipeline() {
+    running_ = false;
+    for (auto& consumer : consumers_) {
+        wake(*consumer);
+        if (consumer->thread.joinable()) {
+            consumer->thread.join();
+        }
+    }
+}
+
+bool RxPipeline::push(WsClient* client,
+                      IClientHandler* target,
+                      ParseMode mode,
+                      std::string_view msg,
+                      std::string_view key,
+                      std::chrono::steady_clock::time_point receivedAt) {
+    // Same key, same consumer: per-channel order is kept
+    size_t shard = 0;
+    if (consumers_.size() > 1) {
+        const size_t hash = key.empty() ? std::hash<const void*>()(client)
+                                        : std::hash<std::string_view>()(key);
+        shard = hash % consumers_.size();
+    }
+    Consumer& consumer = *consumers_[shard];
+    Ring& ring = consumer.ring;
+
+    uint64_t pos;
+    Slot* slot = ring.claimPush(pos);
+    if (!slot) {
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        switch (config_.overflow) {
+            case RxOverflowPolicy::Disconnect:
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+
+            case RxOverflowPolicy::DropOldest: {
+                // At most one eviction per push, and never a wait: when the
+                // slot we need is still in the consumer's hands, the new
+                // message is the one dropped
+                const uint64_t head = ring.enqueuePos_.load(std::memory_order_relaxed);
+                const uint64_t tail = ring.dequeuePos_.load(std::memory_order_acquire);
+                uint64_t oldPos;
+                // Evicting only helps while the slot we need is still queued
+                if (tail + ring.mask_ + 1 <= head) {
+                    if (Slot* old = ring.claimPop(oldPos)) {
+                        done(*old);
+                        ring.release(old, oldPos);
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                if (!(slot = ring.claimPush(pos))) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                break;
+            }
+
+            case RxOverflowPolicy::Block:
+                while (!(slot = ring.claimPush(pos))) {
+                    if (!running_) {
+                        return true;
+                    }
+                    std::this_thread::yield();
+                }
+                break;
+        }
+    }
+
+    // Oversized messages grow the slot once; the slot keeps the capacity
+    if (slot->buf.size() < msg.size()) {
+        slot->buf.resize(msg.size());
+    }
+    memcpy(slot->buf.data(), msg.data(), msg.size());
+    slot->len = msg.size();
+    slot->client = client;
+    slot->target = target;
+    slot->mode = mode;
+    slot->enqueuedAt = std::chrono::steady_clock::now();
+    slot->receivedAt = receivedAt;
+    // Counted before the consumer can see it, flush() waits for zero
+    client->rxQueued_.fetch_add(1, std::memory_order_relaxed);
+    ring.commitPush(slot, pos);
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+
+    wake(consumer);
+    return true;
+}
+
+void RxPipeline::done(const Slot& slot) {
+    // Last access to the client: flush() may return right after this
+    slot.client->rxQueued_.fetch_sub(1, std::memory_order_release);
+}
+
+void RxPipeline::wake(Consumer& consumer) {
+    // Pairs with the sleeping flag set before the consumer's last ring check
+    if (consumer.sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(consumer.mutex);
+        consumer.cv.notify_one();
+    }
+}
+
+void RxPipeline::idle(Consumer& consumer, int& spins) {
+    if (++spins < config_.spinIterations) {
+        return;
+    }
+    spins = 0;
+
+    std::unique_lock<std::mutex> lock(consumer.mutex);
+    consumer.sleeping.store(true, std::memory_order_seq_cst);
+    // The timeout only guards against a missed notification
+    consumer.cv.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+        return !running_ || consumer.ring.size() > 0;
+    });
+    consumer.sleeping.store(false, std::memory_order_relaxed);
+}
+
+void RxPipeline::run(Consumer& consumer, size_t index) {
+    const std::string name = config_.name.substr(0, 12) + "-" + std::to_string(index);
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    currentPipeline = this;
+
+    if (consumer.core >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(consumer.core, &cpuset);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+        if (rc != 0) {
+            logger.error("Failed to pin {} to core {}: {}", name, consumer.core, rc);
+        } else {
+            logger.info("{} pinned to core {}", name, consumer.core);
+        }
+    }
+
+    Ring& ring = consumer.ring;
+    int spins = 0;
+    while (running_) {
+        uint64_t pos;
+        Slot* slot = ring.claimPop(pos);
+        if (!slot) {
+            idle(consumer, spins);
+            continue;
+        }
+        spins = 0;
+
+        const int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - slot->enqueuedAt).count();
+        consumer.lastLagNs.store(lag, std::memory_order_relaxed);
+        consumer.totalLagNs.store(consumer.totalLagNs.load(std::memory_order_relaxed) + lag,
+                                  std::memory_order_relaxed);
+        if (lag > consumer.maxLagNs.load(std::memory_order_relaxed)) {
+            consumer.maxLagNs.store(lag, std::memory_order_relaxed);
+        }
+
+        // The handler reads straight from the slot, it is released afterwards
+        slot->client->dispatch(slot->target, slot->mode,
+                               std::string_view(slot->buf.data(), slot->len),
+                               consumer.doc, consumer.arena, slot->receivedAt);
+
+        done(*slot);
+        ring.release(slot, pos);
+        consumer.processed.store(consumer.processed.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+    }
+}
+
+bool RxPipeline::flush(const WsClient* client) {
+    // Our own ring would never drain while we wait in one of its handlers
+    if (currentPipeline == this) {
+        logger.error("RxPipeline::flush called from a consumer thread, not waiting");
+        return false;
+    }
+    while (running_ && client->rxQueued_.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+RxPipelineStats RxPipeline::stats() const {
+    RxPipelineStats stats;
+    stats.enqueued = enqueued_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.overflows = overflows_.load(std::memory_order_relaxed);
+
+    int64_t last = 0;
+    int64_t max = 0;
+    int64_t total = 0;
+    for (const auto& consumer : consumers_) {
+        stats.processed += consumer->processed.load(std::memory_order_relaxed);
+        stats.depth += consumer->ring.size();
+        last = std::max(last, consumer->lastLagNs.load(std::memory_order_relaxed));
+        max = std::max(max, consumer->maxLagNs.load(std::memory_order_relaxed));
+        total += consumer->totalLagNs.load(std::memory_order_relaxed);
+    }
+    stats.lastLag = std::chrono::nanoseconds(last);
+    stats.maxLag = std::chrono::nanoseconds(max);
+    stats.totalLag = std::chrono::nanoseconds(total);
+    return stats;
+}
+
+MessageArenaStats RxPipeline::arenaStats() const {
+    MessageArenaStats stats;
+    for (const auto& consumer : consumers_) {
+        const MessageArenaStats one = consumer->arena.stats();
+        stats.messages += one.messages;
+        stats.allocations += one.allocations;
+        stats.bytes += one.bytes;
+        stats.heapAllocations += one.heapAllocations;
+        stats.capacity = std::max(stats.capacity, one.capacity);
+        stats.peakBytes = std::max(stats.peakBytes, one.peakBytes);
+    }
+    return stats;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,121 @@
+// stream_router.cpp
+#include <stream_router.h>
+#include <websocket_client_base.h>
+
+namespace cexpp::util::wss {
+
+StreamRouter::StreamRouter(std::vector<std::string> fields, size_t scanBytes)
+    : scanBytes_(scanBytes) {
+    for (const auto& field : fields) {
+        patterns_.push_back("\"" + field + "\":\"");
+    }
+    rehash(16);
+}
+
+uint64_t StreamRouter::hashKey(std::string_view key) {
+    // FNV-1a, keys are short stream names
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : key) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+void StreamRouter::rehash(size_t capacity) {
+    std::vector<Entry> old = std::move(table_);
+    table_.assign(capacity, Entry());
+    mask_ = capacity - 1;
+    for (auto& entry : old) {
+        if (entry.hash) {
+            place(std::move(entry));
+        }
+    }
+}
+
+void StreamRouter::place(Entry&& entry) {
+    size_t i = entry.hash & mask_;
+    while (table_[i].hash) {
+        i = (i + 1) & mask_;
+    }
+    table_[i] = std::move(entry);
+}
+
+StreamRouter::Route& StreamRouter::insert(std::string_view key) {
+    if (Route* route = find(key)) {
+        return *route;
+    }
+
+    // Keep the load factor at or below one half
+    if ((size_ + 1) * 2 > table_.size()) {
+        rehash(table_.size() * 2);
+    }
+
+    const uint64_t hash = hashKey(key);
+    size_t i = hash & mask_;
+    while (table_[i].hash) {
+        i = (i + 1) & mask_;
+    }
+    table_[i].hash = hash;
+    table_[i].key = std::string(key);
+    table_[i].route = Route();
+    size_++;
+    return table_[i].route;
+}
+
+void StreamRouter::add(std::string_view key, IClientHandler* handler) {
+    Route& route = insert(key);
+    route.handler = handler;
+    route.mode = handler->parseMode();
+}
+
+void StreamRouter::remove(std::string_view key) {
+    const uint64_t hash = hashKey(key);
+    for (size_t i = hash & mask_; table_[i].hash; i = (i + 1) & mask_) {
+        if (table_[i].hash == hash && table_[i].key == key) {
+            // Linear probing: re-place the rest of the cluster
+            table_[i] = Entry();
+            size_--;
+            for (size_t j = (i + 1) & mask_; table_[j].hash; j = (j + 1) & mask_) {
+                Entry moved = std::move(table_[j]);
+                table_[j] = Entry();
+                place(std::move(moved));
+            }
+            return;
+        }
+    }
+}
+
+bool StreamRouter::extractKey(std::string_view msg, std::string_view& key) const {
+    const std::string_view head = msg.substr(0, scanBytes_);
+    for (const auto& pattern : patterns_) {
+        const size_t pos = head.find(pattern);
+        if (pos == std::string_view::npos) {
+            continue;
+        }
+        const size_t begin = pos + pattern.size();
+        const size_t end = msg.find('"', begin);
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        key = msg.substr(begin, end - begin);
+        return true;
+    }
+    return false;
+}
+
+const StreamRouter::Route* StreamRouter::find(std::string_view key) const {
+    const uint64_t hash = hashKey(key);
+    for (size_t i = hash & mask_; table_[i].hash; i = (i + 1) & mask_) {
+        if (table_[i].hash == hash && table_[i].key == key) {
+            return &table_[i].route;
+        }
+    }
+    return nullptr;
+}
+
+StreamRouter::Route* StreamRouter::find(std::string_view key) {
+    return const_cast<Route*>(static_cast<const StreamRouter*>(this)->find(key));
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,179 @@
+// typed_messages.cpp
+#include <typed_messages.h>
+#include <charconv>
+#include <cstring>
+
+namespace cexpp::util::wss {
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+size_t skipBlanks(std::string_view json, size_t pos) {
+    while (pos < json.size() && isBlank(json[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Position of the quote closing the string opened at json[open]
+static size_t closingQuote(std::string_view json, size_t open, bool& escaped) {
+    size_t pos = open + 1;
+    for (;;) {
+        const void* hit = std::memchr(json.data() + pos, '"', json.size() - pos);
+        if (!hit) {
+            return std::string_view::npos;
+        }
+        const size_t quote = static_cast<const char*>(hit) - json.data();
+        // Escaped when preceded by an odd run of backslashes
+        size_t backslashes = 0;
+        while (quote - backslashes > open + 1 && json[quote - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes || std::memchr(json.data() + pos, '\\', quote - pos)) {
+            escaped = true;
+        }
+        if (backslashes % 2 == 0) {
+            return quote;
+        }
+        pos = quote + 1;
+    }
+}
+
+// Position just past the object or array opened at json[open]
+static size_t closingBracket(std::string_view json, size_t open) {
+    size_t depth = 0;
+    for (size_t pos = open; pos < json.size(); ++pos) {
+        switch (json[pos]) {
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    return pos + 1;
+                }
+                break;
+            case '"': {
+                bool escaped = false;
+                pos = closingQuote(json, pos, escaped);
+                if (pos == std::string_view::npos) {
+                    return pos;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return std::string_view::npos;
+}
+
+size_t scanValue(std::string_view json, size_t pos, RawValue& out) {
+    pos = skipBlanks(json, pos);
+    if (pos >= json.size()) {
+        return std::string_view::npos;
+    }
+
+    const char c = json[pos];
+    if (c == '"') {
+        out.escaped = false;
+        const size_t end = closingQuote(json, pos, out.escaped);
+        if (end == std::string_view::npos) {
+            return end;
+        }
+        out.kind = RawValue::Kind::String;
+        out.text = json.substr(pos + 1, end - pos - 1);
+        return end + 1;
+    }
+    if (c == '{' || c == '[') {
+        const size_t end = closingBracket(json, pos);
+        if (end == std::string_view::npos) {
+            return end;
+        }
+        out.kind = c == '{' ? RawValue::Kind::Object : RawValue::Kind::Array;
+        out.text = json.substr(pos, end - pos);
+        return end;
+    }
+
+    // Scalar: up to the next delimiter
+    size_t end = pos;
+    while (end < json.size() && json[end] != ',' && json[end] != '}' && json[end] != ']' && !isBlank(json[end])) {
+        ++end;
+    }
+    out.text = json.substr(pos, end - pos);
+    if (out.text == "true") {
+        out.kind = RawValue::Kind::True;
+    } else if (out.text == "false") {
+        out.kind = RawValue::Kind::False;
+    } else if (out.text == "null") {
+        out.kind = RawValue::Kind::Null;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        out.kind = RawValue::Kind::Number;
+    } else {
+        return std::string_view::npos;
+    }
+    return end;
+}
+
+static bool numeric(const RawValue& value) {
+    return value.kind == RawValue::Kind::String || value.kind == RawValue::Kind::Number;
+}
+
+template <typename T>
+static bool parseInteger(const RawValue& value, T& out) {
+    if (!numeric(value)) {
+        return false;
+    }
+    const std::string_view s = value.text;
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+bool decodeValue(const RawValue& value, std::string_view& out) {
+    if (value.kind != RawValue::Kind::String || value.escaped) {
+        return false;
+    }
+    out = value.text;
+    return true;
+}
+
+bool decodeValue(const RawValue& value, int64_t& out) {
+    return parseInteger(value, out);
+}
+
+bool decodeValue(const RawValue& value, uint64_t& out) {
+    return parseInteger(value, out);
+}
+
+bool decodeValue(const RawValue& value, bool& out) {
+    if (value.kind != RawValue::Kind::True && value.kind != RawValue::Kind::False) {
+        return false;
+    }
+    out = value.kind == RawValue::Kind::True;
+    return true;
+}
+
+bool decodeValue(const RawValue& value, double& out) {
+    return numeric(value) && parseDecimal(value.text, out);
+}
+
+bool decodeValue(const RawValue& value, LevelArray& out) {
+    if (value.kind != RawValue::Kind::Array) {
+        return false;
+    }
+    out.assign(value.text);
+    return true;
+}
+
+size_t LevelArray::size() const {
+    size_t n = 0;
+    forEachElement(text_, [&n](const RawValue&) {
+        ++n;
+        return true;
+    });
+    return n;
+}
+
+} // namespace cexpp::util::wss
@@ -1,265 +1,544 @@
 // ws_client.cpp
 #include <ws_client.h>
 #include <iostream>
-#include <spdlog/spdlog.h>
-#include <spdlog/sinks/stdout_color_sinks.h>
-#include <sched.h>  // 添加头文件
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <unordered_set>
+#include <ws_log.h>
 
 namespace cexpp::util::wss {
 
-static std::shared_ptr<spdlog::logger> logger = spdlog::stdout_color_mt("websocket");
-// Define the global variable for logging
-bool wsLogEnabled = false;
+static const WsLogger logger(LogCategory::Client);
+// Define the global variable for logging; the levels start at Info
+std::atomic<bool> wsLogEnabled{true};
 
-int wsCallback(struct lws* wsi,
-               enum lws_callback_reasons reason,
-               void* user,
-               void* in,
-               size_t len);
+void setWsLogEnabled(bool enabled) {
+    wsLogEnabled.store(enabled, std::memory_order_relaxed);
+    for (size_t i = 0; i < static_cast<size_t>(LogCategory::Count); ++i) {
+        setLogLevel(static_cast<LogCategory>(i), enabled ? LogLevel::Info : LogLevel::Off);
+    }
+}
 
 WsClient::~WsClient() {
-    running_ = false;
-    
-    if (serviceThread_.joinable()) {
-        serviceThread_.join();
+    // Closes the connection on the service thread and waits for it, after
+    // this no callback can reach us any more
+    loop_->detach(this);
+    // Messages still queued for our handlers must not outlive us
+    if (rxPipeline_) {
+        rxPipeline_->flush(this);
     }
-    if (subscribeThread_.joinable()) {
-        subscribeThread_.join();
-    }
-    
-    disconnect();
 }
 
 WsClient::WsClient(IClientHandler* handler, 
                    std::string_view url,
                    std::string_view path,
                    uint16_t port,
-                   bool useSSL)
+                   bool useSSL,
+                   const WsClientConfig& config)
     : ClientBase(handler)
     , url_(url)
     , path_(path)
     , port_(port)
-    , useSSL_(useSSL) {
-
-    logger->set_level(spdlog::level::info);
-    
-    // Initialize the first protocol (ws protocol)
-    protocols_[0].name = "ws-protocol";
-    protocols_[0].callback = wsCallback;
-    protocols_[0].per_session_data_size = 0;
-    protocols_[0].rx_buffer_size = 4096;
-    protocols_[0].id = 0;
-    protocols_[0].user = this;
-    protocols_[0].tx_packet_size = 0;
-
-    // Initialize the second protocol (null termination)
-    protocols_[1].name = nullptr;
-    protocols_[1].callback = nullptr;
-    protocols_[1].per_session_data_size = 0;
-    protocols_[1].rx_buffer_size = 0;
-    protocols_[1].id = 0;
-    protocols_[1].user = nullptr;
-    protocols_[1].tx_packet_size = 0;
-    
-    // Start service thread with connect to avoid race conditions
+    , useSSL_(useSSL)
+    , config_(config)
+    , loop_(config.loop ? config.loop : std::make_shared<WsEventLoop>(config.loopConfig))
+    , dnsCache_(config.dnsCache ? config.dnsCache : DnsCache::shared())
+    , arena_(config.arenaBytes)
+    , router_(config.routeFields, config.routeScanBytes)
+    , rxPipeline_(config.rxPipeline)
+    , dedup_(config.dedup)
+    , recorder_(config.recorder)
+    , sendRing_(config.sendRingSlots,
+                config.sendSlotBytes,
+                config.multiProducerSend ? SendRing::Mode::Mpsc : SendRing::Mode::Spsc)
+    , bulkRing_(config.bulkRingSlots, config.sendSlotBytes, SendRing::Mode::Spsc)
+    , sendLimiter_(config.sendRateLimit, config.sendRateBurst)
+    , bulkReserve_(std::clamp(config.bulkLaneReserve, 0.0, std::max(config.sendRateBurst, 1.0) - 1.0)) {
     running_ = true;
     
-    // Pre-resolve DNS to speed up connection
-    if (wsLogEnabled) {
-        logger->info("Pre-resolving DNS for {}", url_);
+    // Resolved on the cache's thread while the rest is set up
+    if (config.connectAddress.empty() && config.autoConnect) {
+        dnsCache_->prefetch(url_, port_);
     }
-    struct addrinfo hints = {0};
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
     
-    struct addrinfo* result;
-    if (getaddrinfo(url_.c_str(), std::to_string(port_).c_str(), &hints, &result) == 0) {
-        // Successfully pre-resolved DNS
-        freeaddrinfo(result);
+    if (config.latencyMetrics) {
+        latency_ = std::make_unique<LatencyRecorder>();
+        if (!config.eventTimeField.empty()) {
+            eventTimeKey_ = "\"" + config.eventTimeField + "\"";
+        }
     }
     
-    // Connect immediately before starting service thread to speed up initialization
-    connect();
+    parseMode_ = handler->parseMode();
+    if (parseMode_ == ParseMode::OnDemand || parseMode_ == ParseMode::Arena) {
+        logger.info("On-demand JSON scanning with {} kernel", JsonDoc::backend());
+    }
     
-    serviceThread_ = std::thread([this]() {
-        // 设置服务线程亲和性
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(-1, &cpuset); // 绑定到核心
-        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    reconnectTimer_.fn = [this]() { onReconnectTimer(); };
+    subscribeTimer_.fn = [this]() { onSubscribeTimer(); };
+    attemptTimer_.fn = [this]() { onAttemptTimer(); };
+    pingTimer_.fn = [this]() { onPingTimer(); };
+    watchdogTimer_.fn = [this]() { onWatchdogTimer(); };
+    throttleTimer_.fn = [this]() {
+        if (connection_) {
+            lws_callback_on_writable(connection_);
+        }
+    };
+    
+    // The connection is opened on the service thread, it owns all lws calls
+    loop_->attach(this);
+    if (!config.autoConnect) {
+        state_ = ConnectionState::Stopped;
+        return;
+    }
+    loop_->post([this]() { connect(); });
+}
+
+void WsClient::connect() {
+    logger.info("Initializing connection to {}:{}{}", url_, port_, path_);
+    
+    state_ = ConnectionState::Connecting;
+    lookupAndAttempt();
+}
+
+void WsClient::lookupAndAttempt() {
+    candidates_.clear();
+    nextCandidate_ = 0;
+    if (!config_.connectAddress.empty()) {
+        candidates_.push_back(config_.connectAddress);
+    } else {
+        switch (dnsCache_->lookup(url_, port_, candidates_)) {
+            case DnsStatus::Resolved:
+                if (!candidates_.empty()) {
+                    std::rotate(candidates_.begin(),
+                                candidates_.begin() + config_.addressOffset % candidates_.size(),
+                                candidates_.end());
+                }
+                break;
+            case DnsStatus::Pending:
+                // First resolution still running on the cache's thread
+                loop_->schedule(attemptTimer_, RESOLVE_POLL_INTERVAL);
+                return;
+            case DnsStatus::Failed:
+                logger.error("Cannot resolve {}", url_);
+                onDisconnected();
+                return;
+        }
+    }
+    startAttempt();
+}
+
+void WsClient::startAttempt() {
+    while (nextCandidate_ < candidates_.size()) {
+        const std::string& address = candidates_[nextCandidate_++];
+        
+        struct lws_client_connect_info ccinfo = {};  // Zero-initialize the struct
+        
+        ccinfo.context = loop_->context();
+        ccinfo.address = address.c_str();
+        ccinfo.port = port_;
+        ccinfo.path = path_.c_str();
+        ccinfo.host = url_.c_str();
+        ccinfo.origin = url_.c_str();
+        ccinfo.protocol = loop_->protocolName();
+        // Per-connection user data: callbacks for this wsi receive the client
+        ccinfo.userdata = this;
+        // Callbacks made before lws returns the wsi find it here
+        ccinfo.pwsi = &pendingWsi_;
         
-        while (running_) {
-            if (context_) {
-                lws_service(context_, 1); // Reduce to 1ms for fastest response time
+        // SSL settings (available in most versions)
+        ccinfo.ssl_connection = useSSL_ ? 
+            LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED | 
+            LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK : 0;
+        
+        logger.info("Connecting to {}:{}{} via {}", url_, port_, path_, address);
+        
+        // The attempt being created is the last one, the only one without a wsi
+        attempts_.push_back({nullptr, address, std::chrono::steady_clock::now()});
+        pendingWsi_ = nullptr;
+        struct lws* wsi = lws_client_connect_via_info(&ccinfo);
+        pendingWsi_ = nullptr;
+        
+        const bool pending = !attempts_.empty() && !attempts_.back().wsi;
+        if (!pending) {
+            // Failed from a callback inside lws, which moved on already
+            return;
+        }
+        if (wsi) {
+            attempts_.back().wsi = wsi;
+            if (nextCandidate_ < candidates_.size() && attempts_.size() < config_.parallelConnects) {
+                loop_->schedule(attemptTimer_, config_.connectAttemptDelay);
             }
-            // Avoid unnecessary sleep that adds latency
-            std::this_thread::yield();
+            return;
         }
-    });
+        dnsCache_->recordFailure(url_, port_, address);
+        attempts_.pop_back();
+    }
     
-    // Start subscribe management thread with optimized timing
-    subscribeThread_ = std::thread([this]() {
-        // 设置订阅线程亲和性
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(-1, &cpuset); // 绑定到核心
-        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-        
-        while (running_) {
-            processSubscribeQueue();
-            std::this_thread::sleep_for(std::chrono::milliseconds(5)); // Reduce from 50ms to 20ms
+    if (attempts_.empty()) {
+        logger.error("Failed to connect to server");
+        onDisconnected();
+    }
+}
+
+void WsClient::onAttemptTimer() {
+    if (!running_ || connection_) {
+        return;
+    }
+    if (candidates_.empty()) {
+        // Waiting for the first resolution
+        lookupAndAttempt();
+        return;
+    }
+    startAttempt();
+}
+
+WsClient::ConnectAttempt* WsClient::findAttempt(struct lws* wsi) {
+    for (auto& attempt : attempts_) {
+        if (attempt.wsi == wsi || (!attempt.wsi && wsi == pendingWsi_)) {
+            return &attempt;
         }
-    });
+    }
+    return nullptr;
 }
 
-void WsClient::connect() {
-    if (wsLogEnabled) {
-        logger->info("Initializing connection to {}:{}{}", url_, port_, path_);
+bool WsClient::onAttemptEstablished(struct lws* wsi) {
+    ConnectAttempt* winner = findAttempt(wsi);
+    if (!winner) {
+        return false;
+    }
+    const auto rtt = std::chrono::steady_clock::now() - winner->start;
+    dnsCache_->recordHandshake(url_, port_, winner->address, rtt);
+    logger.info("Connected to {} in {} us",
+                 winner->address, std::chrono::duration_cast<std::chrono::microseconds>(rtt).count());
+    {
+        std::lock_guard<std::mutex> lock(reconnectStatsMutex_);
+        reconnectStats_.address = winner->address;
     }
+    connection_ = wsi;
     
-    struct lws_context_creation_info info = {};  // Zero-initialize the struct
+    // The other attempts lose, their callbacks no longer find them
+    loop_->cancel(attemptTimer_);
+    for (const auto& attempt : attempts_) {
+        if (attempt.wsi && attempt.wsi != wsi) {
+            lws_set_timeout(attempt.wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+        }
+    }
+    attempts_.clear();
+    candidates_.clear();
+    nextCandidate_ = 0;
+    return true;
+}
+
+void WsClient::onAttemptFailed(struct lws* wsi) {
+    ConnectAttempt* attempt = findAttempt(wsi);
+    if (!attempt) {
+        return;
+    }
+    logger.warn("Connection attempt via {} failed", attempt->address);
+    dnsCache_->recordFailure(url_, port_, attempt->address);
+    attempts_.erase(attempts_.begin() + (attempt - attempts_.data()));
     
-    info.port = CONTEXT_PORT_NO_LISTEN;
-    info.protocols = protocols_;
-    info.gid = -1;
-    info.uid = -1;
-    info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    if (nextCandidate_ < candidates_.size()) {
+        // Next address right away, from the timer: lws may be inside connect
+        loop_->schedule(attemptTimer_, std::chrono::microseconds(0));
+    } else if (attempts_.empty()) {
+        onDisconnected();
+    }
+}
+
+void WsClient::dropAttempts() {
+    loop_->cancel(attemptTimer_);
+    // Cleared first, so the close callbacks find nothing to act on
+    std::vector<ConnectAttempt> attempts;
+    attempts.swap(attempts_);
+    candidates_.clear();
+    nextCandidate_ = 0;
+    for (const auto& attempt : attempts) {
+        if (attempt.wsi) {
+            lws_set_timeout(attempt.wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_SYNC);
+        }
+    }
+}
+
+std::vector<EndpointStats> WsClient::endpointStats() const {
+    if (!config_.connectAddress.empty()) {
+        return {};
+    }
+    return dnsCache_->endpointStats(url_, port_);
+}
+
+void WsClient::shutdown() {
+    running_ = false;
+    state_ = ConnectionState::Stopped;
+    loop_->cancel(reconnectTimer_);
+    loop_->cancel(subscribeTimer_);
+    loop_->cancel(throttleTimer_);
+    loop_->cancel(pingTimer_);
+    loop_->cancel(watchdogTimer_);
+    dropAttempts();
     
-    // Keep-alive settings (available in most versions)
-    info.ka_time = 10; // Keep-alive timeout in seconds
-    info.ka_interval = 5; // Keep-alive interval
-    info.ka_probes = 3; // Number of keep-alive probes
+    if (connection_) {
+        lws_set_timeout(connection_, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_SYNC);
+        connection_ = nullptr;
+    }
+}
+
+void WsClient::reconnect(std::string_view reason) {
+    logger.info("Reconnecting due to: {}", reason);
     
-    // Remove DNS cache settings for compatibility
-    // info.dns_cache_ttl = 300; // Only available in newer versions
-    // info.dns_rev_cache_ttl = 300;
+    loop_->post([this]() {
+        if (!running_ || !connection_) {
+            // Not connected: the state machine is already on its way back
+            return;
+        }
+        // Closing triggers LWS_CALLBACK_CLIENT_CLOSED, which enters backoff
+        lws_set_timeout(connection_, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+    });
+}
+
+void WsClient::onConnected() {
+    state_ = ConnectionState::Connected;
     
-    context_ = lws_create_context(&info);
-    if (!context_) {
-        throw std::runtime_error("Failed to create lws context");
+    if (everConnected_) {
+        resubscribeAll();
     }
+    everConnected_ = true;
     
-    struct lws_client_connect_info ccinfo = {};  // Zero-initialize the struct
-    
-    ccinfo.context = context_;
-    ccinfo.address = url_.c_str();
-    ccinfo.port = port_;
-    ccinfo.path = path_.c_str();
-    ccinfo.host = url_.c_str();
-    ccinfo.origin = url_.c_str();
-    ccinfo.protocol = protocols_[0].name;
+    // Fresh liveness state: every watched stream gets a full timeout to
+    // deliver on the new connection
+    pingOutstanding_ = false;
+    pingDue_ = false;
+    if (config_.pingInterval.count() > 0) {
+        loop_->schedule(pingTimer_, config_.pingInterval);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    router_.forEach([now](std::string_view, StreamRouter::Route& route) {
+        route.seenAtCheck = route.seen;
+        route.lastProgress = now;
+    });
+    armWatchdog();
     
-    // SSL settings (available in most versions)
-    ccinfo.ssl_connection = useSSL_ ? 
-        LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED | 
-        LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK : 0;
+    // Only outages of an established connection count, not the initial connect
+    if (outageStart_ != std::chrono::steady_clock::time_point{}) {
+        const auto outage = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - outageStart_);
+        {
+            std::lock_guard<std::mutex> lock(reconnectStatsMutex_);
+            reconnectStats_.reconnects++;
+            reconnectStats_.lastOutage = outage;
+            reconnectStats_.maxOutage = std::max(reconnectStats_.maxOutage, outage);
+            reconnectStats_.totalOutage += outage;
+        }
+        logger.info("Reconnected after {} attempts, outage {} us",
+                     reconnectAttempt_, outage.count() / 1000);
+        outageStart_ = {};
+    }
+    reconnectAttempt_ = 0;
+}
+
+void WsClient::onDisconnected() {
+    connection_ = nullptr;
+    // Subscription traffic is rebuilt from the tables on the next connection
+    bulkRing_.clear();
+    loop_->cancel(pingTimer_);
+    loop_->cancel(watchdogTimer_);
+    if (!running_) {
+        return;
+    }
     
-    if (wsLogEnabled) {
-        logger->info("Connecting to {}:{}{}", url_, port_, path_);
+    if (state_ == ConnectionState::Connected) {
+        // A fresh outage starts now
+        outageStart_ = std::chrono::steady_clock::now();
     }
+    state_ = ConnectionState::Backoff;
+    
+    const auto delay = nextBackoff();
+    logger.info("Reconnect attempt {} in {} ms", reconnectAttempt_ + 1, delay.count() / 1000);
+    loop_->schedule(reconnectTimer_, delay);
+}
+
+std::chrono::microseconds WsClient::nextBackoff() {
+    using namespace std::chrono;
     
-    connection_ = lws_client_connect_via_info(&ccinfo);
+    const int shift = std::min(reconnectAttempt_, 16);
+    auto delay = duration_cast<microseconds>(config_.reconnectBaseDelay) * (int64_t{1} << shift);
+    delay = std::min(delay, duration_cast<microseconds>(config_.reconnectMaxDelay));
     
-    if (!connection_) {
-        throw std::runtime_error("Failed to connect to server");
+    const double jitter = std::clamp(config_.reconnectJitter, 0.0, 1.0);
+    if (jitter > 0) {
+        std::uniform_real_distribution<double> dist(1.0 - jitter, 1.0 + jitter);
+        delay = microseconds(static_cast<int64_t>(delay.count() * dist(backoffRng_)));
     }
+    return delay;
 }
 
-void WsClient::disconnect() {
-    if (connection_) {
-        lws_callback_on_writable(connection_);
-        connection_ = nullptr;
+void WsClient::onReconnectTimer() {
+    if (!running_ || connection_ || !attempts_.empty()) {
+        return;
     }
     
-    if (context_) {
-        lws_context_destroy(context_);
-        context_ = nullptr;
+    reconnectAttempt_++;
+    {
+        std::lock_guard<std::mutex> lock(reconnectStatsMutex_);
+        reconnectStats_.attempts++;
     }
+    
+    connect();
 }
 
-void WsClient::reconnect(std::string_view reason) {
-    if (wsLogEnabled) {
-        logger->info("Reconnecting due to: {}", reason);
+void WsClient::send(std::string_view payload) const {
+    if (!trySend(payload)) {
+        logger.error("Send queue congested ({} frames), dropping message", sendRing_.size());
     }
-    
-    // Add a small delay before reconnecting to avoid rapid reconnection attempts
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    
-    disconnect();
-    
-    // Try to connect up to 3 times with increasing backoff
-    for (int attempt = 0; attempt < 3; attempt++) {
-        try {
-            logger->info("Connection attempt {} of 3", attempt + 1);
-            connect();
-            logger->info("Connection successful");
-            
-            // Successfully connected, no need to try more
-            break;
-        } catch (const std::exception& e) {
-            if (wsLogEnabled) {
-                logger->error("Reconnect attempt {} failed: {}", attempt + 1, e.what());
+}
+
+bool WsClient::trySend(std::string_view payload) const {
+    const size_t hwm = config_.sendHighWaterMark;
+    if (hwm) {
+        const size_t depth = sendRing_.size();
+        if (depth >= hwm) {
+            if (!sendCongested_.exchange(true) && backpressureCallback_) {
+                backpressureCallback_(depth, true);
             }
-            
-            // Last attempt failed, but we've run out of retries
-            if (attempt == 2) {
-                logger->error("All reconnection attempts failed");
-                return;
+            if (config_.backpressurePolicy == BackpressurePolicy::Reject) {
+                return false;
             }
-            
-            // Exponential backoff for next attempt
-            std::this_thread::sleep_for(std::chrono::milliseconds(500 * (1 << attempt)));
         }
     }
     
-    // For Binance direct streams, we don't need to resubscribe
-    if (path_.find("/ws/") == 0) {
-        logger->info("Using direct stream URL - no resubscription needed");
-        return;
+    // Single copy into a preallocated LWS_PRE-padded slot
+    if (!sendRing_.push(payload)) {
+        return false;
     }
     
-    // For non-direct streams, resubscribe to active subscriptions
-    std::lock_guard<std::mutex> lock(subMutex_);
-    logger->info("Resubscribing to active streams");
-    
-    for (const auto& [name, status] : subscribeStatus_) {
-        if (status) {
-            SubscribeRequest req{
-                name,
-                handler->genSubscribePayload(name, false),
-                "",
-                true,
-                false,
-                std::chrono::steady_clock::now()
-            };
-            subscribeQueue_.push(req);
-        }
+    // One wake-up per drain, further sends ride along
+    if (!writeRequested_.exchange(true)) {
+        loop_->requestWritable(this);
     }
-    subCv_.notify_one();
+    return true;
 }
 
-void WsClient::send(std::string_view payload) const {
-    std::lock_guard<std::mutex> lock(sendMutex_);
-    // Pre-allocate buffer with LWS_PRE padding
-    static thread_local std::vector<unsigned char> buffer(LWS_PRE + 4096);
-    if (buffer.size() < LWS_PRE + payload.length()) {
-        buffer.resize(LWS_PRE + payload.length());
+size_t WsClient::sendQueueDepth() const {
+    return sendRing_.size();
+}
+
+void WsClient::sendBulk(std::string_view payload) {
+    // Service thread only: the bulk ring has a single producer
+    if (!bulkRing_.push(payload)) {
+        logger.error("Bulk send ring full ({} frames), dropping message", bulkRing_.capacity());
+        return;
     }
-    memcpy(buffer.data() + LWS_PRE, payload.data(), payload.length());
-    
-    sendQueue_.push(std::string(payload)); // Still need to queue for async sending
-    sendCv_.notify_one();
-    
     if (connection_) {
         lws_callback_on_writable(connection_);
     }
 }
 
+int WsClient::drainSendQueues(struct lws* wsi) {
+    // Coalesce: drain as many frames as the socket and the rate limiter take
+    // in this callback instead of one frame per service loop round trip
+    const auto now = std::chrono::steady_clock::now();
+    int budget = config_.maxWritesPerCallback;
+    double reserve = 0;
+    bool throttled = false;
+    
+    // Pings count against the exchange's message rate like any other frame
+    if (pingDue_) {
+        if (!sendLimiter_.tryTake(now, 0)) {
+            throttled = true;
+            budget = 0;
+        } else if (writePing(wsi) < 0) {
+            return -1;
+        }
+    }
+    
+    while (budget-- > 0) {
+        // High priority first, bulk only when no user frame is waiting
+        SendRing* ring = &sendRing_;
+        LaneCounters* lane = &highLane_;
+        reserve = 0;
+        auto* slot = ring->front();
+        if (!slot) {
+            ring = &bulkRing_;
+            lane = &bulkLane_;
+            reserve = bulkReserve_;
+            slot = ring->front();
+        }
+        if (!slot) {
+            break;
+        }
+        if (!sendLimiter_.tryTake(now, reserve)) {
+            throttled = true;
+            break;
+        }
+        
+        // Write straight from the ring slot, its LWS_PRE headroom is ours
+        int written = lws_write(wsi, slot->payload(), slot->len, LWS_WRITE_TEXT);
+        if (written < 0) {
+            return -1;
+        }
+        
+        const int64_t delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - slot->enqueuedAt).count();
+        ring->pop();
+        lane->sent.store(lane->sent.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        lane->lastNs.store(delay, std::memory_order_relaxed);
+        lane->totalNs.store(lane->totalNs.load(std::memory_order_relaxed) + delay,
+                            std::memory_order_relaxed);
+        if (delay > lane->maxNs.load(std::memory_order_relaxed)) {
+            lane->maxNs.store(delay, std::memory_order_relaxed);
+        }
+        loop_->txMessages_.fetch_add(1, std::memory_order_relaxed);
+        
+        if (lws_send_pipe_choked(wsi)) {
+            break;
+        }
+    }
+    
+    const size_t depth = sendRing_.size();
+    if (throttled) {
+        // Come back when the bucket has a token again
+        throttled_.fetch_add(1, std::memory_order_relaxed);
+        loop_->schedule(throttleTimer_, std::chrono::duration_cast<std::chrono::microseconds>(
+            sendLimiter_.timeUntilToken(now, reserve)));
+    } else if (depth || !bulkRing_.empty()) {
+        lws_callback_on_writable(wsi);
+    }
+    
+    // Clear again at half the mark; <= so a mark of 1 clears when drained
+    const size_t hwm = config_.sendHighWaterMark;
+    if (hwm && depth <= hwm / 2 && sendCongested_.exchange(false) && backpressureCallback_) {
+        backpressureCallback_(depth, false);
+    }
+    return 0;
+}
+
+SendStats WsClient::sendStats() const {
+    auto read = [](const LaneCounters& lane) {
+        SendLaneStats stats;
+        stats.sent = lane.sent.load(std::memory_order_relaxed);
+        stats.lastQueueDelay = std::chrono::nanoseconds(lane.lastNs.load(std::memory_order_relaxed));
+        stats.maxQueueDelay = std::chrono::nanoseconds(lane.maxNs.load(std::memory_order_relaxed));
+        stats.totalQueueDelay = std::chrono::nanoseconds(lane.totalNs.load(std::memory_order_relaxed));
+        return stats;
+    };
+    
+    SendStats stats;
+    stats.high = read(highLane_);
+    stats.bulk = read(bulkLane_);
+    stats.throttled = throttled_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ReconnectStats WsClient::reconnectStats() const {
+    std::lock_guard<std::mutex> lock(reconnectStatsMutex_);
+    return reconnectStats_;
+}
+
 void WsClient::subscribe(std::string_view name,
                         std::string_view payload,
                         std::string_view successKey,
                         bool waitOk) {
-    std::lock_guard<std::mutex> lock(subMutex_);
     SubscribeRequest req{
         std::string(name),      // Need to copy for storage
         std::string(payload),   // Need to copy for storage
@@ -268,15 +547,13 @@ void WsClient::subscribe(std::string_view name,
         false,
         std::chrono::steady_clock::now()
     };
-    subscribeQueue_.push(std::move(req));  // Use move to avoid extra copy
-    subCv_.notify_one();
+    loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
 }
 
 void WsClient::unSubscribe(std::string_view name,
                           std::string_view payload,
                           std::string_view successKey,
                           bool waitOk) {
-    std::lock_guard<std::mutex> lock(subMutex_);
     SubscribeRequest req{
         std::string(name),
         std::string(payload),
@@ -285,20 +562,100 @@ void WsClient::unSubscribe(std::string_view name,
         true,
         std::chrono::steady_clock::now()
     };
-    subscribeQueue_.push(req);
-    subCv_.notify_one();
+    loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
 }
 
 void WsClient::subscribeDynamic(std::string_view name,
                               std::string_view successKey,
                               bool waitOk) {
-    subscribe(name, handler->genSubscribePayload(std::string(name), false), successKey, waitOk);
+    SubscribeRequest req{
+        std::string(name),
+        handler->genSubscribePayload(std::string(name), false),
+        std::string(successKey),
+        waitOk,
+        false,
+        std::chrono::steady_clock::now()
+    };
+    req.dynamic = true;
+    loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
 }
 
 void WsClient::unSubscribeDynamic(std::string_view name,
                                  std::string_view successKey,
                                  bool waitOk) {
-    unSubscribe(name, handler->genSubscribePayload(std::string(name), true), successKey, waitOk);
+    SubscribeRequest req{
+        std::string(name),
+        handler->genSubscribePayload(std::string(name), true),
+        std::string(successKey),
+        waitOk,
+        true,
+        std::chrono::steady_clock::now()
+    };
+    req.dynamic = true;
+    loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
+}
+
+bool WsClient::makeBatches(const std::vector<std::string>& names,
+                           std::string_view successKey,
+                           bool waitOk,
+                           bool unSub,
+                           std::vector<SubscribeRequest>& out) {
+    const size_t batchSize = std::max<size_t>(config_.subscribeBatchSize, 1);
+    const auto now = std::chrono::steady_clock::now();
+    
+    for (size_t first = 0; first < names.size(); first += batchSize) {
+        std::vector<std::string> chunk(names.begin() + first,
+                                       names.begin() + std::min(first + batchSize, names.size()));
+        std::string payload = handler->genBatchSubscribePayload(chunk, unSub);
+        if (payload.empty()) {
+            // Handler has no batch format
+            return false;
+        }
+        
+        SubscribeRequest req{
+            fmt::format("{} (+{} more)", chunk.front(), chunk.size() - 1),
+            std::move(payload),
+            std::string(successKey),
+            waitOk,
+            unSub,
+            now
+        };
+        req.dynamic = true;
+        req.names = std::move(chunk);
+        out.push_back(std::move(req));
+    }
+    return true;
+}
+
+void WsClient::subscribeMany(const std::vector<std::string>& names,
+                             std::string_view successKey,
+                             bool waitOk) {
+    std::vector<SubscribeRequest> batches;
+    if (!makeBatches(names, successKey, waitOk, false, batches)) {
+        ClientBase::subscribeMany(names, successKey, waitOk);
+        return;
+    }
+    for (auto& req : batches) {
+        loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
+    }
+}
+
+void WsClient::unSubscribeMany(const std::vector<std::string>& names,
+                               std::string_view successKey,
+                               bool waitOk) {
+    std::vector<SubscribeRequest> batches;
+    if (!makeBatches(names, successKey, waitOk, true, batches)) {
+        ClientBase::unSubscribeMany(names, successKey, waitOk);
+        return;
+    }
+    for (auto& req : batches) {
+        loop_->post([this, req = std::move(req)]() { startSubscribe(req); });
+    }
+}
+
+SubscribeStats WsClient::subscribeStats() const {
+    std::lock_guard<std::mutex> lock(subMutex_);
+    return subscribeStats_;
 }
 
 bool WsClient::isSubscribeOk(std::string_view name) {
@@ -311,71 +668,833 @@ bool WsClient::isUnsubscribeOk(std::string_view name) {
     return unsubscribeStatus_[std::string(name)];  // Need string for map lookup
 }
 
-void WsClient::processMessage(const std::string& msg) {
-    // Fast path: first try to handle subscribe response without JSON parsing
-    if (!subscribeQueue_.empty()) {
+// Reads the unsigned integer value of a top-level style "key":N pair without
+// parsing the document. Good enough for JSON-RPC ids such as Binance's
+// {"result":null,"id":312}.
+static bool findUintField(std::string_view json, std::string_view quotedKey, uint64_t& value) {
+    size_t pos = json.find(quotedKey);
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+    pos += quotedKey.size();
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == ':')) {
+        ++pos;
+    }
+    if (pos >= json.size() || json[pos] < '0' || json[pos] > '9') {
+        return false;
+    }
+    value = 0;
+    while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
+        value = value * 10 + static_cast<uint64_t>(json[pos++] - '0');
+    }
+    return true;
+}
+
+static size_t skipBlanks(std::string_view json, size_t pos) {
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n')) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Position just past the string opening at pos, npos if unterminated
+static size_t skipString(std::string_view json, size_t pos) {
+    for (++pos; pos < json.size(); ++pos) {
+        if (json[pos] == '\\') {
+            ++pos;
+        } else if (json[pos] == '"') {
+            return pos + 1;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Position just past the value starting at pos, npos if malformed
+static size_t skipValue(std::string_view json, size_t pos) {
+    int depth = 0;
+    while (pos < json.size()) {
+        const char c = json[pos];
+        if (c == '"') {
+            pos = skipString(json, pos);
+            if (pos == std::string_view::npos) {
+                return pos;
+            }
+            if (depth == 0) {
+                return pos;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) {
+                return pos;
+            }
+            if (--depth == 0) {
+                return pos + 1;
+            }
+        } else if (c == ',' && depth == 0) {
+            return pos;
+        }
+        ++pos;
+    }
+    return depth == 0 ? pos : std::string_view::npos;
+}
+
+// Reply to a request: an object with a top-level "id" and a "result" or
+// "error" member. Only top-level members count, an "id" nested in market
+// data never acks a request. Market data ("stream" or "e" member) is
+// rejected at that key, normally the first one.
+static bool findReplyId(std::string_view json, uint64_t& id, bool& error) {
+    size_t pos = skipBlanks(json, 0);
+    if (pos >= json.size() || json[pos] != '{') {
+        return false;
+    }
+    bool hasId = false;
+    bool hasResult = false;
+    error = false;
+    pos = skipBlanks(json, pos + 1);
+    while (pos < json.size() && json[pos] == '"') {
+        const size_t end = skipString(json, pos);
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        const std::string_view key = json.substr(pos + 1, end - pos - 2);
+        pos = skipBlanks(json, end);
+        if (pos >= json.size() || json[pos] != ':') {
+            return false;
+        }
+        pos = skipBlanks(json, pos + 1);
+        if (key == "stream" || key == "e") {
+            return false;
+        }
+        if (key == "id") {
+            hasId = pos < json.size() && json[pos] >= '0' && json[pos] <= '9';
+            id = 0;
+            for (size_t i = pos; i < json.size() && json[i] >= '0' && json[i] <= '9'; ++i) {
+                id = id * 10 + static_cast<uint64_t>(json[i] - '0');
+            }
+        } else if (key == "result") {
+            hasResult = true;
+        } else if (key == "error") {
+            error = true;
+        }
+        pos = skipValue(json, pos);
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        pos = skipBlanks(json, pos);
+        if (pos < json.size() && json[pos] == ',') {
+            pos = skipBlanks(json, pos + 1);
+        }
+    }
+    return hasId && (hasResult || error);
+}
+
+void WsClient::processMessage(std::string_view msg) {
+    if (recorder_) {
+        recorder_->record(config_.recordConnection, msg);
+    }
+    
+    // Acks are only looked for while requests are in flight
+    if (!pendingSubs_.empty()) {
         handleSubscribeResponse(msg);
     }
     
+    // Set by the receive callback; messages injected from elsewhere are not timed
+    std::chrono::steady_clock::time_point receivedAt{};
+    if (latency_ && rxStart_ != std::chrono::steady_clock::time_point{}) {
+        receivedAt = rxStart_;
+        latency_->reassembly.record(rxFramed_ - receivedAt);
+        if (!eventTimeKey_.empty()) {
+            recordEventTime(msg);
+        }
+        rxStart_ = {};
+    }
+    
+    // Per-channel routing and watchdog accounting on a key scanned from the
+    // raw frame: messages nobody registered for can be dropped before any
+    // parsing
+    std::string_view key;
+    StreamRouter::Route* route = nullptr;
+    if (!router_.empty() || dedup_) {
+        route = router_.extractKey(msg, key) ? router_.find(key) : nullptr;
+    }
+    if (route) {
+        // Counted on every leg, the watchdog watches the connection
+        route->seen++;
+    }
+    
+    // Redundant legs: only the first copy of an update goes on
+    if (dedup_ && !dedup_->firstArrival(config_.dedupLeg, key, msg)) {
+        return;
+    }
+    
+    if (route) {
+        if (route->handler) {
+            deliver(route->handler, route->mode, msg, key, receivedAt);
+        } else {
+            deliver(handler, parseMode_, msg, key, receivedAt);
+        }
+        return;
+    }
+    if (!router_.empty() && config_.dropUnrouted) {
+        return;
+    }
+    
+    deliver(handler, parseMode_, msg, key, receivedAt);
+}
+
+void WsClient::deliver(IClientHandler* target,
+                       ParseMode mode,
+                       std::string_view msg,
+                       std::string_view key,
+                       std::chrono::steady_clock::time_point receivedAt) {
+    if (!rxPipeline_) {
+        dispatch(target, mode, msg, jsonDoc_, arena_, receivedAt);
+        return;
+    }
+    
+    // Hand-off: the handler runs on a consumer thread
+    if (!rxPipeline_->push(this, target, mode, msg, key, receivedAt)) {
+        logger.error("Receive queue full, dropping connection");
+        reconnect("receive queue overflow");
+    }
+}
+
+void WsClient::dispatch(IClientHandler* target,
+                        ParseMode mode,
+                        std::string_view msg,
+                        JsonDoc& doc,
+                        MessageArena& arena,
+                        std::chrono::steady_clock::time_point receivedAt) {
+    using clock = std::chrono::steady_clock;
+    
+    // Stage timestamps, only taken for timed messages
+    const bool timed = latency_ && receivedAt != clock::time_point{};
+    const clock::time_point dispatchedAt = timed ? clock::now() : clock::time_point{};
+    clock::time_point parsedAt{};
+    
     try {
-        auto json = nlohmann::json::parse(msg);
-        handler->onMessage(json);
+        if (mode == ParseMode::Dom) {
+            if (!target->onRawMessage(msg)) {
+                // Malformed input yields a discarded value instead of an exception
+                auto json = nlohmann::json::parse(msg.begin(), msg.end(), nullptr, false);
+                if (timed) {
+                    parsedAt = clock::now();
+                }
+                if (json.is_discarded()) {
+                    target->onMessage(std::string(msg));
+                } else {
+                    target->onMessage(json);
+                }
+            }
+        } else {
+            // Whatever the handler decodes can live in the arena, it is reset
+            // when the scope closes
+            ArenaScope scope(arena);
+            switch (mode) {
+                case ParseMode::Raw:
+                    target->onRawMessage(msg);
+                    break;
+                
+                case ParseMode::OnDemand: {
+                    if (target->onRawMessage(msg)) {
+                        break;
+                    }
+                    // Structural index only, values are decoded when the handler asks
+                    const bool ok = doc.parse(msg);
+                    if (timed) {
+                        parsedAt = clock::now();
+                    }
+                    if (ok) {
+                        target->onDocument(doc);
+                    } else {
+                        target->onMessage(std::string(msg));
+                    }
+                    break;
+                }
+                
+                case ParseMode::Arena: {
+                    if (target->onRawMessage(msg)) {
+                        break;
+                    }
+                    const ArenaJson* json = doc.parse(msg) ? &buildArenaJson(doc.root()) : nullptr;
+                    if (timed) {
+                        parsedAt = clock::now();
+                    }
+                    if (json) {
+                        target->onArenaMessage(*json);
+                    } else {
+                        target->onMessage(std::string(msg));
+                    }
+                    break;
+                }
+                
+                case ParseMode::Dom:
+                    break;
+            }
+        }
     } catch (const std::exception& e) {
-        handler->onMessage(msg);
+        // Never let a handler exception unwind into lws
+        logger.error("Handler threw while processing message: {}", e.what());
+    }
+    
+    if (timed) {
+        const clock::time_point doneAt = clock::now();
+        if (parsedAt != clock::time_point{}) {
+            latency_->parse.record(parsedAt - dispatchedAt);
+            latency_->handler.record(doneAt - parsedAt);
+        } else {
+            // Raw handlers: no parse stage
+            latency_->handler.record(doneAt - dispatchedAt);
+        }
+        latency_->total.record(doneAt - receivedAt);
+    }
+}
+
+void WsClient::stampReceive() {
+    rxStart_ = std::chrono::steady_clock::now();
+    if (!eventTimeKey_.empty()) {
+        rxWall_ = std::chrono::system_clock::now();
     }
 }
 
-void WsClient::processSubscribeQueue() {
-    std::unique_lock<std::mutex> lock(subMutex_);
+void WsClient::recordEventTime(std::string_view msg) {
+    // Event time sits in the header fields, no need to look further
+    const size_t pos = msg.substr(0, 256).find(eventTimeKey_);
+    uint64_t eventTime;
+    if (pos == std::string_view::npos || !findUintField(msg.substr(pos), eventTimeKey_, eventTime)) {
+        return;
+    }
     
-    while (!subscribeQueue_.empty()) {
-        auto& req = subscribeQueue_.front();
-        auto now = std::chrono::steady_clock::now();
-        
-        if (now - req.lastTryTime >= RETRY_INTERVAL) {
-            if (req.retryCount < MAX_RETRY_COUNT) {
-                send(req.payload);
-                req.lastTryTime = now;
-                req.retryCount++;
-            } else {
-                if (wsLogEnabled) {
-                    logger->error("Subscribe request failed after max retries: {}", req.name);
+    // Milliseconds, microseconds or nanoseconds since the epoch, by magnitude
+    int64_t eventNs = static_cast<int64_t>(eventTime);
+    if (eventTime < 100000000000000ULL) {
+        eventNs *= 1000000;
+    } else if (eventTime < 100000000000000000ULL) {
+        eventNs *= 1000;
+    }
+    const int64_t localNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        rxWall_.time_since_epoch()).count();
+    const int64_t delta = localNs - eventNs;
+    
+    LatencyRecorder& rec = *latency_;
+    if (delta < 0) {
+        // Our clock is behind the exchange's by more than the path delay
+        rec.negativeExchangeDelays.fetch_add(1, std::memory_order_relaxed);
+    }
+    rec.exchange.record(delta);
+    
+    // Offset estimate: minimum delta over the current and the previous
+    // window. That is the clock offset plus the fastest path delay seen, the
+    // best a one-way feed allows; windows let it follow clock drift.
+    if (rxStart_ - rec.windowStart > LatencyRecorder::OFFSET_WINDOW) {
+        rec.previousMin = rec.currentMin;
+        rec.currentMin = INT64_MAX;
+        rec.windowStart = rxStart_;
+    }
+    rec.currentMin = std::min(rec.currentMin, delta);
+    rec.clockOffsetNs.store(std::min(rec.previousMin, rec.currentMin), std::memory_order_relaxed);
+    rec.lastExchangeDelayNs.store(delta, std::memory_order_relaxed);
+}
+
+LatencyMetrics WsClient::latencyMetrics() const {
+    LatencyMetrics metrics;
+    if (!latency_) {
+        return metrics;
+    }
+    metrics.reassembly = latency_->reassembly.snapshot();
+    metrics.parse = latency_->parse.snapshot();
+    metrics.handler = latency_->handler.snapshot();
+    metrics.total = latency_->total.snapshot();
+    metrics.exchange = latency_->exchange.snapshot();
+    metrics.clockOffset = std::chrono::nanoseconds(latency_->clockOffsetNs.load(std::memory_order_relaxed));
+    metrics.lastExchangeDelay = std::chrono::nanoseconds(
+        latency_->lastExchangeDelayNs.load(std::memory_order_relaxed));
+    metrics.negativeExchangeDelays = latency_->negativeExchangeDelays.load(std::memory_order_relaxed);
+    return metrics;
+}
+
+MessageArenaStats WsClient::arenaStats() const {
+    return arena_.stats();
+}
+
+void WsClient::addRoute(std::string_view channel, IClientHandler* channelHandler) {
+    loop_->post([this, key = std::string(channel), channelHandler]() {
+        router_.add(key, channelHandler);
+    });
+}
+
+void WsClient::removeRoute(std::string_view channel) {
+    loop_->post([this, key = std::string(channel)]() {
+        StreamRouter::Route* route = router_.find(key);
+        if (!route) {
+            return;
+        }
+        // A watched stream keeps its entry, only the handler goes
+        if (route->staleAfter.count() > 0) {
+            route->handler = nullptr;
+        } else {
+            router_.remove(key);
+        }
+    });
+}
+
+void WsClient::watchStream(std::string_view stream, std::chrono::milliseconds timeout) {
+    loop_->post([this, key = std::string(stream), timeout]() {
+        if (timeout.count() <= 0) {
+            StreamRouter::Route* route = router_.find(key);
+            if (route && !route->handler) {
+                router_.remove(key);
+            } else if (route) {
+                route->staleAfter = std::chrono::milliseconds(0);
+            }
+            return;
+        }
+        StreamRouter::Route& route = router_.insert(key);
+        route.staleAfter = timeout;
+        route.seenAtCheck = route.seen;
+        route.lastProgress = std::chrono::steady_clock::now();
+        armWatchdog();
+    });
+}
+
+void WsClient::armWatchdog() {
+    if (state_ != ConnectionState::Connected) {
+        return;
+    }
+    
+    // Check at a quarter of the shortest timeout: silence is detected
+    // within 1.25 timeouts at worst
+    std::chrono::milliseconds shortest{0};
+    router_.forEach([&shortest](std::string_view, StreamRouter::Route& route) {
+        if (route.staleAfter.count() > 0 && (!shortest.count() || route.staleAfter < shortest)) {
+            shortest = route.staleAfter;
+        }
+    });
+    if (shortest.count() > 0) {
+        loop_->schedule(watchdogTimer_, std::max(shortest / 4, std::chrono::milliseconds(10)));
+    }
+}
+
+void WsClient::onWatchdogTimer() {
+    if (!running_ || state_ != ConnectionState::Connected) {
+        return;
+    }
+    
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<std::string, std::chrono::milliseconds>> stale;
+    router_.forEach([&](std::string_view key, StreamRouter::Route& route) {
+        if (route.staleAfter.count() <= 0) {
+            return;
+        }
+        if (route.seen != route.seenAtCheck) {
+            route.seenAtCheck = route.seen;
+            route.lastProgress = now;
+            return;
+        }
+        const auto silence = std::chrono::duration_cast<std::chrono::milliseconds>(now - route.lastProgress);
+        if (silence > route.staleAfter) {
+            stale.emplace_back(std::string(key), silence);
+            // Re-arm: fire again only after another full timeout of silence
+            route.lastProgress = now;
+        }
+    });
+    
+    for (const auto& [stream, silence] : stale) {
+        staleEvents_.fetch_add(1, std::memory_order_relaxed);
+        logger.warn("Stream {} silent for {} ms", stream, silence.count());
+        if (staleCallback_) {
+            staleCallback_(stream, silence);
+        }
+    }
+    
+    if (!stale.empty() && config_.staleAction == StaleAction::Reconnect) {
+        reconnect("stale stream " + stale.front().first);
+        return;
+    }
+    armWatchdog();
+}
+
+void WsClient::onPingTimer() {
+    if (!running_ || !connection_ || state_ != ConnectionState::Connected) {
+        return;
+    }
+    
+    const auto now = std::chrono::steady_clock::now();
+    if (pingOutstanding_) {
+        if (now - pingSentAt_ > config_.pongTimeout) {
+            pongTimeouts_.fetch_add(1, std::memory_order_relaxed);
+            logger.warn("No pong within {} ms", config_.pongTimeout.count());
+            reconnect("pong timeout");
+            return;
+        }
+    } else {
+        // The ping goes out with the next WRITEABLE, ahead of queued frames
+        pingDue_ = true;
+        lws_callback_on_writable(connection_);
+    }
+    loop_->schedule(pingTimer_, config_.pingInterval);
+}
+
+void WsClient::onPong(const void* payload, size_t len) {
+    // Only the pong to our outstanding ping counts, servers may send
+    // unsolicited ones
+    uint64_t seq;
+    const char* text = static_cast<const char*>(payload);
+    auto [ptr, ec] = std::from_chars(text, text + len, seq);
+    if (!pingOutstanding_ || ec != std::errc() || ptr != text + len || seq != pingSeq_) {
+        return;
+    }
+    pingOutstanding_ = false;
+    
+    const int64_t rtt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - pingSentAt_).count();
+    const uint64_t pongs = pongs_.load(std::memory_order_relaxed) + 1;
+    pongs_.store(pongs, std::memory_order_relaxed);
+    lastRttNs_.store(rtt, std::memory_order_relaxed);
+    totalRttNs_.store(totalRttNs_.load(std::memory_order_relaxed) + rtt, std::memory_order_relaxed);
+    if (pongs == 1 || rtt < minRttNs_.load(std::memory_order_relaxed)) {
+        minRttNs_.store(rtt, std::memory_order_relaxed);
+    }
+    if (rtt > maxRttNs_.load(std::memory_order_relaxed)) {
+        maxRttNs_.store(rtt, std::memory_order_relaxed);
+    }
+}
+
+int WsClient::writePing(struct lws* wsi) {
+    unsigned char buf[LWS_PRE + 24];
+    char* payload = reinterpret_cast<char*>(buf + LWS_PRE);
+    auto [end, ec] = std::to_chars(payload, payload + 24, ++pingSeq_);
+    (void)ec;
+    const size_t len = static_cast<size_t>(end - payload);
+    if (lws_write(wsi, buf + LWS_PRE, len, LWS_WRITE_PING) < static_cast<int>(len)) {
+        return -1;
+    }
+    pingDue_ = false;
+    pingOutstanding_ = true;
+    pingSentAt_ = std::chrono::steady_clock::now();
+    pingsSent_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+LivenessStats WsClient::livenessStats() const {
+    LivenessStats stats;
+    stats.pingsSent = pingsSent_.load(std::memory_order_relaxed);
+    stats.pongsReceived = pongs_.load(std::memory_order_relaxed);
+    stats.pongTimeouts = pongTimeouts_.load(std::memory_order_relaxed);
+    stats.staleEvents = staleEvents_.load(std::memory_order_relaxed);
+    stats.lastRtt = std::chrono::nanoseconds(lastRttNs_.load(std::memory_order_relaxed));
+    stats.minRtt = std::chrono::nanoseconds(minRttNs_.load(std::memory_order_relaxed));
+    stats.maxRtt = std::chrono::nanoseconds(maxRttNs_.load(std::memory_order_relaxed));
+    if (stats.pongsReceived) {
+        stats.avgRtt = std::chrono::nanoseconds(
+            totalRttNs_.load(std::memory_order_relaxed) / static_cast<int64_t>(stats.pongsReceived));
+    }
+    return stats;
+}
+
+void WsClient::setStaleStreamCallback(std::function<void(const std::string&, std::chrono::milliseconds)> callback) {
+    staleCallback_ = std::move(callback);
+}
+
+void WsClient::subscribeRouted(std::string_view name,
+                               IClientHandler* channelHandler,
+                               std::string_view successKey,
+                               bool waitOk) {
+    // Route first: the loop runs posted work in order, so the route is in
+    // place before the first message of the channel can arrive
+    addRoute(name, channelHandler);
+    subscribeDynamic(name, successKey, waitOk);
+}
+
+void WsClient::startSubscribe(SubscribeRequest req) {
+    req.hasId = findUintField(req.payload, "\"id\"", req.id);
+    
+    if (!req.waitOk) {
+        // Fire and forget: counts as established right away
+        sendBulk(req.payload);
+        completeSubscribe(req, true);
+        return;
+    }
+    
+    uint64_t key = req.id;
+    if (!req.hasId || pendingSubs_.count(key)) {
+        // Local keys live in the upper half so they never meet a real id
+        key = (uint64_t{1} << 63) | nextLocalKey_++;
+        req.hasId = false;
+        keyMatchedPending_++;
+    }
+    
+    req.firstTryTime = std::chrono::steady_clock::now();
+    req.retryCount = 0;
+    sendSubscribe(req);
+    pendingSubs_.emplace(key, std::move(req));
+    
+    {
+        std::lock_guard<std::mutex> lock(subMutex_);
+        subscribeStats_.sent++;
+        subscribeStats_.inFlight = pendingSubs_.size();
+    }
+    armSubscribeTimer();
+}
+
+void WsClient::sendSubscribe(SubscribeRequest& req) {
+    req.lastTryTime = std::chrono::steady_clock::now();
+    if (!connection_) {
+        // Offline: resubscribeAll() sends it again once connected, so the
+        // attempt does not count against MAX_RETRY_COUNT
+        return;
+    }
+    sendBulk(req.payload);
+    req.retryCount++;
+}
+
+void WsClient::completeSubscribe(SubscribeRequest& req, bool ok) {
+    // A batch frame settles every channel it carried
+    std::vector<std::string> names = req.names;
+    if (names.empty()) {
+        names.push_back(req.name);
+    }
+    
+    if (ok) {
+        for (const auto& name : names) {
+            if (req.isUnsubscribe) {
+                activeSubs_.erase(name);
+                router_.remove(name);
+                continue;
+            }
+            if (config_.staleStreamTimeout.count() > 0) {
+                // Watch from the ack on, unless the stream has its own timeout
+                StreamRouter::Route& route = router_.insert(name);
+                if (route.staleAfter.count() <= 0) {
+                    route.staleAfter = config_.staleStreamTimeout;
+                    route.seenAtCheck = route.seen;
+                    route.lastProgress = std::chrono::steady_clock::now();
+                    armWatchdog();
                 }
-                subscribeQueue_.pop();
             }
+            if (req.names.empty()) {
+                activeSubs_[name] = req;
+                continue;
+            }
+            // Batch member: remembered as a dynamic single channel, the
+            // resubscribe regroups them into batches again
+            SubscribeRequest member{name, "", req.successKey, req.waitOk, false, req.lastTryTime};
+            member.dynamic = true;
+            activeSubs_[name] = std::move(member);
         }
-        
-        if (req.waitOk) {
-            subCv_.wait_for(lock, RETRY_INTERVAL);
+    } else {
+        logger.error("Subscribe request failed: {}", req.name);
+    }
+    
+    std::lock_guard<std::mutex> lock(subMutex_);
+    if (ok) {
+        for (const auto& name : names) {
+            if (req.isUnsubscribe) {
+                unsubscribeStatus_[name] = true;
+                subscribeStatus_[name] = false;
+            } else {
+                subscribeStatus_[name] = true;
+                unsubscribeStatus_[name] = false;
+            }
+            // Add to pending callbacks
+            pendingCallbacks_.emplace_back(name, req.isUnsubscribe);
+        }
+    }
+    
+    if (req.waitOk) {
+        if (ok) {
+            const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - req.firstTryTime);
+            subscribeStats_.acked++;
+            subscribeStats_.lastAckLatency = latency;
+            subscribeStats_.maxAckLatency = std::max(subscribeStats_.maxAckLatency, latency);
         } else {
-            subscribeQueue_.pop();
+            subscribeStats_.failed++;
         }
+        subscribeStats_.inFlight = pendingSubs_.size();
     }
 }
 
-void WsClient::handleSubscribeResponse(const std::string& msg) {
-    std::lock_guard<std::mutex> lock(subMutex_);
+void WsClient::handleSubscribeResponse(std::string_view msg) {
+    uint64_t id;
+    bool error;
+    if (findReplyId(msg, id, error)) {
+        auto it = pendingSubs_.find(id);
+        if (it != pendingSubs_.end() && it->second.hasId) {
+            SubscribeRequest req = std::move(it->second);
+            pendingSubs_.erase(it);
+            completeSubscribe(req, !error);
+            armSubscribeTimer();
+            return;
+        }
+    }
     
-    if (!subscribeQueue_.empty()) {
-        auto& req = subscribeQueue_.front();
-        if (!req.successKey.empty() && msg.find(req.successKey) != std::string::npos) {
-            if (req.isUnsubscribe) {
-                unsubscribeStatus_[req.name] = true;
-                subscribeStatus_[req.name] = false;
-                
-                // Add to pending callbacks
-                pendingCallbacks_.emplace_back(req.name, true);
+    // Requests without an id: match on their success key
+    if (keyMatchedPending_ == 0) {
+        return;
+    }
+    for (auto it = pendingSubs_.begin(); it != pendingSubs_.end(); ++it) {
+        auto& req = it->second;
+        if (!req.hasId && !req.successKey.empty() &&
+            msg.find(req.successKey) != std::string_view::npos) {
+            SubscribeRequest done = std::move(req);
+            pendingSubs_.erase(it);
+            keyMatchedPending_--;
+            completeSubscribe(done, true);
+            armSubscribeTimer();
+            return;
+        }
+    }
+}
+
+void WsClient::onSubscribeTimer() {
+    // Frames sent while disconnected would only be duplicated by the
+    // resubscribe after the handshake
+    if (state_ != ConnectionState::Connected) {
+        return;
+    }
+    
+    const auto now = std::chrono::steady_clock::now();
+    uint64_t retries = 0;
+    for (auto it = pendingSubs_.begin(); it != pendingSubs_.end();) {
+        auto& req = it->second;
+        if (now - req.lastTryTime < RETRY_INTERVAL) {
+            ++it;
+            continue;
+        }
+        if (req.retryCount < MAX_RETRY_COUNT) {
+            sendSubscribe(req);
+            retries++;
+            ++it;
+            continue;
+        }
+        
+        logger.error("Subscribe request failed after max retries: {}", req.name);
+        SubscribeRequest failed = std::move(req);
+        if (!failed.hasId) {
+            keyMatchedPending_--;
+        }
+        it = pendingSubs_.erase(it);
+        completeSubscribe(failed, false);
+    }
+    
+    if (retries) {
+        std::lock_guard<std::mutex> lock(subMutex_);
+        subscribeStats_.retries += retries;
+    }
+    armSubscribeTimer();
+}
+
+void WsClient::armSubscribeTimer() {
+    if (pendingSubs_.empty()) {
+        loop_->cancel(subscribeTimer_);
+        return;
+    }
+    
+    // One timer for all requests, due at the earliest retry deadline
+    auto due = std::chrono::steady_clock::time_point::max();
+    for (const auto& [key, req] : pendingSubs_) {
+        due = std::min(due, req.lastTryTime + RETRY_INTERVAL);
+    }
+    const auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+        due - std::chrono::steady_clock::now());
+    loop_->schedule(subscribeTimer_, std::max(delay, std::chrono::microseconds(0)));
+}
+
+void WsClient::resubscribeAll() {
+    // Requests in flight on the lost connection, in the order they were made.
+    // Channels with an unsubscribe among them are not restored below, or the
+    // restore would subscribe them again after the unsubscribe.
+    std::vector<std::pair<std::chrono::steady_clock::time_point, uint64_t>> inFlight;
+    std::unordered_set<std::string> unsubscribing;
+    for (const auto& [key, req] : pendingSubs_) {
+        inFlight.emplace_back(req.firstTryTime, key);
+        if (req.isUnsubscribe) {
+            unsubscribing.insert(req.name);
+            unsubscribing.insert(req.names.begin(), req.names.end());
+        }
+    }
+    std::sort(inFlight.begin(), inFlight.end());
+    
+    std::vector<SubscribeRequest> restore;
+    std::unordered_set<std::string> restored;
+    if (path_.find("/ws/") == 0) {
+        // For Binance direct streams, we don't need to resubscribe
+        logger.info("Using direct stream URL - no resubscription needed");
+    } else {
+        // Resubscribe to active subscriptions, all at once: the acks are
+        // matched by id, not in order
+        logger.info("Resubscribing to {} active streams", activeSubs_.size());
+        restore.reserve(activeSubs_.size());
+        
+        // Dynamic channels are regrouped into batch frames when the handler
+        // supports it, so hundreds of channels cost a handful of frames. A
+        // frame only carries channels that settle the same way.
+        std::map<std::pair<std::string, bool>, std::vector<std::string>> groups;
+        for (const auto& [name, req] : activeSubs_) {
+            if (unsubscribing.count(name)) {
+                continue;
+            }
+            restored.insert(name);
+            if (req.dynamic) {
+                groups[{req.successKey, req.waitOk}].push_back(name);
             } else {
-                subscribeStatus_[req.name] = true;
-                unsubscribeStatus_[req.name] = false;
-                
-                // Add to pending callbacks
-                pendingCallbacks_.emplace_back(req.name, false);
+                restore.push_back(req);
             }
-            subscribeQueue_.pop();
-            subCv_.notify_one();
         }
+        
+        for (const auto& [settle, names] : groups) {
+            const auto& [successKey, waitOk] = settle;
+            if (makeBatches(names, successKey, waitOk, false, restore)) {
+                continue;
+            }
+            for (const auto& name : names) {
+                SubscribeRequest req{
+                    name,
+                    handler->genSubscribePayload(name, false),
+                    successKey,
+                    waitOk,
+                    false,
+                    std::chrono::steady_clock::now()
+                };
+                req.dynamic = true;
+                restore.push_back(std::move(req));
+            }
+        }
+    }
+    
+    for (auto& req : restore) {
+        startSubscribe(std::move(req));
     }
+    
+    // Then the requests in flight, sent again from scratch. A subscribe the
+    // restore already covers is dropped: its channels get acked there.
+    for (const auto& [firstTry, key] : inFlight) {
+        auto it = pendingSubs_.find(key);
+        auto& req = it->second;
+        const bool covered = !req.isUnsubscribe &&
+            (req.names.empty() ? restored.count(req.name) > 0
+                               : std::all_of(req.names.begin(), req.names.end(),
+                                             [&](const std::string& name) { return restored.count(name) > 0; }));
+        if (covered) {
+            if (!req.hasId) {
+                keyMatchedPending_--;
+            }
+            pendingSubs_.erase(it);
+            continue;
+        }
+        req.retryCount = 0;
+        sendSubscribe(req);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(subMutex_);
+        subscribeStats_.inFlight = pendingSubs_.size();
+    }
+    armSubscribeTimer();
 }
 
 void WsClient::setSubscriptionCallback(std::function<void(const std::string&, bool)> callback) {
@@ -386,6 +1505,10 @@ void WsClient::setUnsubscriptionCallback(std::function<void(const std::string&,
     unsubscriptionCallback_ = std::move(callback);
 }
 
+void WsClient::setBackpressureCallback(std::function<void(size_t, bool)> callback) {
+    backpressureCallback_ = std::move(callback);
+}
+
 void WsClient::processEvents() {
     // Process any pending events in the main thread
     // This can be called regularly from the main loop
@@ -417,6 +1540,55 @@ void WsClient::processEvents() {
     }
 }
 
+CompressionStats WsClient::compressionStats() const {
+    CompressionStats stats;
+    stats.compressedBytes = compressedBytes_.load(std::memory_order_relaxed);
+    stats.decompressedBytes = decompressedBytes_.load(std::memory_order_relaxed);
+    stats.inflateTime = std::chrono::nanoseconds(inflateNs_.load(std::memory_order_relaxed));
+    return stats;
+}
+
+int wsExtensionCallback(struct lws_context* context,
+                        const struct lws_extension* ext,
+                        struct lws* wsi,
+                        enum lws_extension_callback_reasons reason,
+                        void* user,
+                        void* in,
+                        size_t len) {
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+    auto* client = reason == LWS_EXT_CB_PAYLOAD_RX && wsi && in
+        ? static_cast<WsClient*>(lws_wsi_user(wsi)) : nullptr;
+    if (!client) {
+        return lws_extension_callback_pm_deflate(context, ext, wsi, reason, user, in, len);
+    }
+    
+    auto* ebufs = static_cast<struct lws_ext_pm_deflate_rx_ebufs*>(in);
+    const uint8_t* inToken = ebufs->eb_in.token;
+    const int inLen = ebufs->eb_in.len;
+    const auto start = std::chrono::steady_clock::now();
+    const int rc = lws_extension_callback_pm_deflate(context, ext, wsi, reason, user, in, len);
+    
+    // Frames sent without RSV1 pass through untouched, the output then still
+    // aliases the input; inflated output lands in the extension's own buffer
+    if (ebufs->eb_out.token && ebufs->eb_out.token != inToken) {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        const int consumed = inLen - ebufs->eb_in.len;
+        client->compressedBytes_.store(
+            client->compressedBytes_.load(std::memory_order_relaxed) + std::max(consumed, 0),
+            std::memory_order_relaxed);
+        client->decompressedBytes_.store(
+            client->decompressedBytes_.load(std::memory_order_relaxed) + std::max(ebufs->eb_out.len, 0),
+            std::memory_order_relaxed);
+        client->inflateNs_.store(client->inflateNs_.load(std::memory_order_relaxed) + ns,
+                                 std::memory_order_relaxed);
+    }
+    return rc;
+#else
+    return 0;
+#endif
+}
+
 int wsCallback(struct lws* wsi,
                enum lws_callback_reasons reason,
                void* user,
@@ -427,65 +1599,99 @@ int wsCallback(struct lws* wsi,
         return 0;
     }
 
-    // Get protocol and validate it exists
-    struct lws_protocols const* protocol = lws_get_protocol(wsi);
-    if (!protocol || !protocol->user) {
+    // Work handed over from other threads via lws_cancel_service()
+    if (reason == LWS_CALLBACK_EVENT_WAIT_CANCELLED) {
+        auto* loop = static_cast<WsEventLoop*>(lws_context_user(lws_get_context(wsi)));
+        if (loop) {
+            loop->runPending();
+        }
+        return 0;
+    }
+    
+    // Every client connection carries its WsClient as per-wsi user data
+    if (!user) {
         return 0;
     }
     
-    auto* client = static_cast<WsClient*>(protocol->user);
+    auto* client = static_cast<WsClient*>(user);
     
     switch (reason) {
         case LWS_CALLBACK_CLIENT_ESTABLISHED: {
-            if (wsLogEnabled) {
-                logger->info("Connection established");
+            if (!client->onAttemptEstablished(wsi)) {
+                // An attempt that lost the race got through anyway
+                return -1;
             }
+            logger.info("Connection established");
+            client->onConnected();
+            
+            // Drop any partial message left over from the previous connection
+            client->rxBuffer_.clear();
             client->handler->onUpdate();
+            
+            // Frames queued while we were disconnected
+            if (!client->sendRing_.empty() || !client->bulkRing_.empty()) {
+                lws_callback_on_writable(wsi);
+            }
             break;
         }
         
         case LWS_CALLBACK_CLIENT_RECEIVE: {
-            const auto* payload = static_cast<unsigned char*>(in);
-            std::string msg(reinterpret_cast<char*>(const_cast<unsigned char*>(payload)), len);
-            client->processMessage(msg);
+            const bool isFinal = lws_is_final_fragment(wsi);
+            // A message's latency clock starts at the callback entry of its
+            // first piece
+            if (client->latency_ && client->rxBuffer_.empty()) {
+                client->stampReceive();
+            }
+            auto& loop = *client->loop_;
+            loop.rxBytes_.fetch_add(len, std::memory_order_relaxed);
+            if (isFinal) {
+                loop.rxMessages_.fetch_add(1, std::memory_order_relaxed);
+            }
+            
+            // Fast path: the whole message arrived in one callback, hand out
+            // a view straight into lws' buffer without copying
+            if (isFinal && client->rxBuffer_.empty()) {
+                client->rxFramed_ = client->rxStart_;
+                client->processMessage(std::string_view(static_cast<const char*>(in), len));
+                break;
+            }
+            
+            // Large frames are split by rx_buffer_size and messages may be
+            // fragmented: reassemble in place until the final piece arrives
+            client->rxBuffer_.append(in, len, lws_remaining_packet_payload(wsi));
+            if (isFinal) {
+                if (client->latency_) {
+                    client->rxFramed_ = std::chrono::steady_clock::now();
+                }
+                client->processMessage(client->rxBuffer_.view());
+                client->rxBuffer_.clear();
+            }
             break;
         }
         
-        case LWS_CALLBACK_CLIENT_WRITEABLE: {
-            std::lock_guard<std::mutex> lock(client->sendMutex_);
-            if (!client->sendQueue_.empty()) {
-                std::string& msg = client->sendQueue_.front();
-                
-                unsigned char buf[LWS_PRE + msg.length()];
-                memcpy(&buf[LWS_PRE], msg.data(), msg.length());
-                
-                int written = lws_write(wsi, &buf[LWS_PRE], msg.length(), LWS_WRITE_TEXT);
-                if (written < 0) {
-                    return -1;
-                }
-                
-                client->sendQueue_.pop();
-                if (!client->sendQueue_.empty()) {
-                    lws_callback_on_writable(wsi);
-                }
-            }
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG: {
+            client->onPong(in, len);
             break;
         }
         
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            return client->drainSendQueues(wsi);
+        }
+        
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR: {
             const char* error_msg = in ? static_cast<const char*>(in) : "Unknown error";
-            if (wsLogEnabled) {
-                logger->error("Connection error: {}", error_msg);
-            }
-            client->reconnect("Connection error");
+            logger.error("Connection error: {}", error_msg);
+            client->onAttemptFailed(wsi);
             break;
         }
         
         case LWS_CALLBACK_CLIENT_CLOSED: {
-            if (wsLogEnabled) {
-                logger->warn("Connection closed");
+            if (wsi != client->connection_) {
+                client->onAttemptFailed(wsi);
+                break;
             }
-            client->reconnect("Connection closed");
+            logger.warn("Connection closed");
+            client->onDisconnected();
             break;
         }
         
@@ -0,0 +1,254 @@
+// ws_event_loop.cpp
+#include <ws_event_loop.h>
+#include <ws_client.h>
+#include <algorithm>
+#include <future>
+#include <pthread.h>
+#include <sched.h>
+#include <ws_log.h>
+
+namespace cexpp::util::wss {
+
+static const WsLogger logger(LogCategory::Loop);
+
+// Extension offer as sent in Sec-WebSocket-Extensions. 15 bits is the
+// protocol default and is left implicit.
+static std::string deflateOffer(const DeflateConfig& deflate) {
+    std::string offer = "permessage-deflate; client_max_window_bits";
+    const int clientBits = std::clamp(deflate.clientMaxWindowBits, 8, 15);
+    const int serverBits = std::clamp(deflate.serverMaxWindowBits, 8, 15);
+    if (clientBits < 15) {
+        offer += "=" + std::to_string(clientBits);
+    }
+    if (serverBits < 15) {
+        offer += "; server_max_window_bits=" + std::to_string(serverBits);
+    }
+    if (deflate.serverNoContextTakeover) {
+        offer += "; server_no_context_takeover";
+    }
+    if (deflate.clientNoContextTakeover) {
+        offer += "; client_no_context_takeover";
+    }
+    return offer;
+}
+
+WsEventLoop::WsEventLoop(const WsEventLoopConfig& config)
+    : config_(config) {
+    // Initialize the first protocol (ws protocol). Connections carry their
+    // WsClient as per-wsi user data, the protocol itself has no user.
+    protocols_[0] = {};
+    protocols_[0].name = "ws-protocol";
+    protocols_[0].callback = wsCallback;
+    protocols_[0].rx_buffer_size = config_.rxBufferSize;
+
+    // Initialize the second protocol (null termination)
+    protocols_[1] = {};
+
+    struct lws_context_creation_info info = {};  // Zero-initialize the struct
+
+    info.port = CONTEXT_PORT_NO_LISTEN;
+    info.protocols = protocols_;
+    info.gid = -1;
+    info.uid = -1;
+    info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    info.user = this;
+
+    if (config_.deflate.enabled) {
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+        deflateOffer_ = deflateOffer(config_.deflate);
+        extensions_[0] = {};
+        extensions_[0].name = "permessage-deflate";
+        extensions_[0].callback = wsExtensionCallback;
+        extensions_[0].client_offer = deflateOffer_.c_str();
+        extensions_[1] = {};
+        info.extensions = extensions_;
+        logger.info("Offering {}", deflateOffer_);
+#else
+        logger.error("libwebsockets built without extensions, permessage-deflate disabled");
+#endif
+    }
+
+    // Keep-alive settings (available in most versions)
+    info.ka_time = 10; // Keep-alive timeout in seconds
+    info.ka_interval = 5; // Keep-alive interval
+    info.ka_probes = 3; // Number of keep-alive probes
+
+    context_ = lws_create_context(&info);
+    if (!context_) {
+        throw std::runtime_error("Failed to create lws context");
+    }
+
+    running_ = true;
+    serviceThread_ = std::thread([this]() { run(); });
+}
+
+WsEventLoop::~WsEventLoop() {
+    running_ = false;
+    // Breaks a Blocking loop out of poll
+    lws_cancel_service(context_);
+    if (serviceThread_.joinable()) {
+        serviceThread_.join();
+    }
+
+    lws_context_destroy(context_);
+    context_ = nullptr;
+}
+
+void WsEventLoop::run() {
+    serviceThreadId_.store(std::this_thread::get_id());
+    applyAffinity();
+
+    if (config_.mode == LoopMode::BusyPoll) {
+        while (running_) {
+            if (hasPending_.load(std::memory_order_acquire)) {
+                runPending();
+            }
+            // Negative timeout: poll the sockets without waiting
+            lws_service(context_, -1);
+        }
+        return;
+    }
+    
+    while (running_) {
+        // Waits until socket activity, the next timer or lws_cancel_service()
+        lws_service(context_, 0);
+    }
+}
+
+void WsEventLoop::wake() {
+    if (config_.mode == LoopMode::BusyPoll) {
+        hasPending_.store(true, std::memory_order_release);
+        return;
+    }
+    lws_cancel_service(context_);
+}
+
+void WsEventLoop::applyAffinity() {
+    pthread_setname_np(pthread_self(), config_.name.substr(0, 15).c_str());
+    
+    if (config_.cpuCore < 0) {
+        return;
+    }
+    
+    // 设置服务线程亲和性
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(config_.cpuCore, &cpuset); // 绑定到核心
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) {
+        logger.error("Failed to pin {} to core {}: {}", config_.name, config_.cpuCore, rc);
+    } else {
+        logger.info("{} pinned to core {}", config_.name, config_.cpuCore);
+    }
+}
+
+bool WsEventLoop::inServiceThread() const {
+    return std::this_thread::get_id() == serviceThreadId_.load();
+}
+
+void WsEventLoop::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pendingTasks_.push_back(std::move(task));
+    }
+    wake();
+}
+
+void WsEventLoop::requestWritable(const WsClient* client) {
+    if (inServiceThread()) {
+        client->writeRequested_ = false;
+        if (client->connection_) {
+            lws_callback_on_writable(client->connection_);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pendingWrites_.push_back(client);
+    }
+    wake();
+}
+
+void WsEventLoop::schedule(LoopTimer& timer, std::chrono::microseconds delay) {
+    lws_sul_schedule(context_, 0, &timer.sul, &LoopTimer::fire, delay.count());
+}
+
+void WsEventLoop::cancel(LoopTimer& timer) {
+    lws_sul_cancel(&timer.sul);
+}
+
+void WsEventLoop::runPending() {
+    // Swap out under the lock, run without it so tasks can post again
+    static thread_local std::vector<std::function<void()>> tasks;
+    static thread_local std::vector<const WsClient*> writes;
+    hasPending_.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        tasks.swap(pendingTasks_);
+        writes.swap(pendingWrites_);
+    }
+
+    // Writes first: a detach queued in tasks may release one of these clients
+    for (auto* client : writes) {
+        client->writeRequested_ = false;
+        if (client->connection_) {
+            lws_callback_on_writable(client->connection_);
+        }
+    }
+    writes.clear();
+
+    for (auto& task : tasks) {
+        task();
+    }
+    tasks.clear();
+}
+
+void WsEventLoop::attach(WsClient* client) {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    clients_.push_back(client);
+}
+
+void WsEventLoop::detach(WsClient* client) {
+    auto close = [this, client]() {
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+        }
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            pendingWrites_.erase(std::remove(pendingWrites_.begin(), pendingWrites_.end(), client),
+                                 pendingWrites_.end());
+        }
+        client->shutdown();
+    };
+
+    if (inServiceThread()) {
+        close();
+        return;
+    }
+
+    std::promise<void> done;
+    post([&close, &done]() {
+        close();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+size_t WsEventLoop::clientCount() const {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    return clients_.size();
+}
+
+WsEventLoopStats WsEventLoop::stats() const {
+    WsEventLoopStats stats;
+    stats.clients = clientCount();
+    stats.rxMessages = rxMessages_.load(std::memory_order_relaxed);
+    stats.rxBytes = rxBytes_.load(std::memory_order_relaxed);
+    stats.txMessages = txMessages_.load(std::memory_order_relaxed);
+    stats.cpuCore = config_.cpuCore;
+    return stats;
+}
+
+} // namespace cexpp::util::wss
@@ -0,0 +1,66 @@
+// ws_event_loop_pool.cpp
+#include <ws_event_loop_pool.h>
+#include <stdexcept>
+#include <string>
+
+namespace cexpp::util::wss {
+
+WsEventLoopPool::WsEventLoopPool(const WsEventLoopPoolConfig& config)
+    : config_(config) {
+    const size_t count = config_.cores.empty() ? config_.shards : config_.cores.size();
+    if (count == 0) {
+        throw std::invalid_argument("Event loop pool needs at least one shard");
+    }
+
+    shards_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        WsEventLoopConfig loopConfig = config_.loop;
+        loopConfig.cpuCore = config_.cores.empty() ? -1 : config_.cores[i];
+        loopConfig.name = config_.loop.name + "-" + std::to_string(i);
+        shards_.push_back(std::make_shared<WsEventLoop>(loopConfig));
+    }
+}
+
+std::shared_ptr<WsEventLoop> WsEventLoopPool::pick(std::string_view key) {
+    return shards_[select(key) % shards_.size()];
+}
+
+size_t WsEventLoopPool::select(std::string_view key) {
+    if (config_.selector) {
+        return config_.selector(key, stats());
+    }
+
+    switch (config_.policy) {
+        case ShardPolicy::LeastLoaded: {
+            size_t best = 0;
+            WsEventLoopStats bestStats = shards_[0]->stats();
+            for (size_t i = 1; i < shards_.size(); ++i) {
+                WsEventLoopStats s = shards_[i]->stats();
+                if (s.clients < bestStats.clients ||
+                    (s.clients == bestStats.clients && s.rxMessages < bestStats.rxMessages)) {
+                    best = i;
+                    bestStats = s;
+                }
+            }
+            return best;
+        }
+
+        case ShardPolicy::HashByKey:
+            return std::hash<std::string_view>{}(key);
+
+        case ShardPolicy::RoundRobin:
+        default:
+            return next_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::vector<WsEventLoopStats> WsEventLoopPool::stats() const {
+    std::vector<WsEventLoopStats> result;
+    result.reserve(shards_.size());
+    for (const auto& shard : shards_) {
+        result.push_back(shard->stats());
+    }
+    return result;
+}
+
+} // namespace cexpp::util::wss
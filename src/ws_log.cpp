@@ -0,0 +1,213 @@
+// ws_log.cpp
+#include <ws_log.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <memory>
+#include <thread>
+
+namespace cexpp::util::wss {
+
+namespace detail {
+
+std::atomic<uint8_t> logLevels[static_cast<size_t>(LogCategory::Count)] = {1, 1, 1, 1, 1, 1, 1};
+
+} // namespace detail
+
+static const char* const categoryNames[] = {
+    "websocket", "websocket-loop", "websocket-rx", "websocket-capture", "websocket-redundant", "websocket-book",
+    "websocket-dns",
+};
+static_assert(std::size(categoryNames) == static_cast<size_t>(LogCategory::Count));
+
+static spdlog::level::level_enum toSpdlog(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug:
+            return spdlog::level::debug;
+        case LogLevel::Info:
+            return spdlog::level::info;
+        case LogLevel::Warn:
+            return spdlog::level::warn;
+        case LogLevel::Error:
+            return spdlog::level::err;
+        default:
+            return spdlog::level::off;
+    }
+}
+
+// Bounded multi-producer queue of records (per-slot sequence numbers, as in
+// SendRing) drained by one writer thread. Producers never block and never
+// make a system call; when the writer falls behind, records are dropped and
+// counted instead.
+class LogWriter {
+public:
+    static constexpr size_t capacity = 4096;
+    static constexpr auto idleWait = std::chrono::milliseconds(1);
+
+    LogWriter() : records_(new detail::LogRecord[capacity]) {
+        for (size_t i = 0; i < capacity; ++i) {
+            records_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        // Resolved up front so the spdlog registry outlives this writer
+        for (size_t i = 0; i < std::size(categoryNames); ++i) {
+            loggers_[i] = spdlog::get(categoryNames[i]);
+            if (!loggers_[i]) {
+                loggers_[i] = spdlog::stdout_color_mt(categoryNames[i]);
+                // Levels are checked at the call site
+                loggers_[i]->set_level(spdlog::level::trace);
+            }
+        }
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~LogWriter() {
+        stop_.store(true, std::memory_order_release);
+        thread_.join();
+    }
+
+    detail::LogRecord* claim() {
+        uint64_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            detail::LogRecord& record = records_[pos & (capacity - 1)];
+            const uint64_t seq = record.seq.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return &record;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commit(detail::LogRecord* record) {
+        record->seq.store(record->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void flush() {
+        const uint64_t target = enqueuePos_.load(std::memory_order_acquire);
+        while (synced_.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(idleWait);
+        }
+    }
+
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() {
+        for (;;) {
+            // Read before draining so records committed ahead of a stop
+            // request are still written
+            const bool stopping = stop_.load(std::memory_order_acquire);
+            if (drain()) {
+                continue;
+            }
+            sync();
+            if (stopping) {
+                break;
+            }
+            std::this_thread::sleep_for(idleWait);
+        }
+    }
+
+    // Caught up: report drops and flush the sinks before waking flush()
+    void sync() {
+        const uint64_t written = written_.load(std::memory_order_relaxed);
+        const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (written == synced_.load(std::memory_order_relaxed) && dropped == reported_) {
+            return;
+        }
+        if (dropped != reported_) {
+            loggers_[0]->warn("log queue full, {} records dropped", dropped - reported_);
+            reported_ = dropped;
+        }
+        for (const auto& logger : loggers_) {
+            logger->flush();
+        }
+        synced_.store(written, std::memory_order_release);
+    }
+
+    // Writes every record ready in order, false when there was none
+    bool drain() {
+        bool any = false;
+        for (;;) {
+            const uint64_t pos = written_.load(std::memory_order_relaxed);
+            detail::LogRecord& record = records_[pos & (capacity - 1)];
+            if (record.seq.load(std::memory_order_acquire) != pos + 1) {
+                return any;
+            }
+            write(record);
+            record.seq.store(pos + capacity, std::memory_order_release);
+            written_.store(pos + 1, std::memory_order_release);
+            any = true;
+        }
+    }
+
+    void write(const detail::LogRecord& record) {
+        buf_.clear();
+        try {
+            record.render(record.format, record.args, &buf_);
+        } catch (const std::exception& e) {
+            buf_.clear();
+            fmt::format_to(std::back_inserter(buf_), "bad log format \"{}\": {}", record.format, e.what());
+        }
+        const auto& logger = loggers_[static_cast<size_t>(record.category)];
+        logger->log(record.time, spdlog::source_loc{}, toSpdlog(record.level),
+                    spdlog::string_view_t(buf_.data(), buf_.size()));
+    }
+
+    std::unique_ptr<detail::LogRecord[]> records_;
+    std::shared_ptr<spdlog::logger> loggers_[static_cast<size_t>(LogCategory::Count)];
+    alignas(64) std::atomic<uint64_t> enqueuePos_{0};
+    std::atomic<uint64_t> dropped_{0};
+    alignas(64) std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> synced_{0};
+    uint64_t reported_{0};
+    spdlog::memory_buf_t buf_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+static LogWriter& logWriter() {
+    static LogWriter writer;
+    return writer;
+}
+
+namespace detail {
+
+LogRecord* claimLogRecord() {
+    return logWriter().claim();
+}
+
+void commitLogRecord(LogRecord* record) {
+    logWriter().commit(record);
+}
+
+} // namespace detail
+
+void setLogLevel(LogCategory category, LogLevel level) {
+    detail::logLevels[static_cast<size_t>(category)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+LogLevel logLevel(LogCategory category) {
+    return static_cast<LogLevel>(detail::logLevels[static_cast<size_t>(category)].load(std::memory_order_relaxed));
+}
+
+const char* logCategoryName(LogCategory category) {
+    return categoryNames[static_cast<size_t>(category)];
+}
+
+void flushLogs() {
+    logWriter().flush();
+}
+
+uint64_t droppedLogRecords() {
+    return logWriter().dropped();
+}
+
+} // namespace cexpp::util::wss
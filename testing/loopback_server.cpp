@@ -0,0 +1,243 @@
+// loopback_server.cpp
+#include <loopback_server.h>
+#include <algorithm>
+#include <pthread.h>
+#include <stdexcept>
+#include <time.h>
+
+namespace cexpp::util::wss::testing {
+
+LoopbackServer::LoopbackServer(const LoopbackServerConfig& config)
+    : config_(config) {
+    protocols_[0] = {};
+    protocols_[0].name = "ws-protocol";
+    protocols_[0].callback = callback;
+    protocols_[0].per_session_data_size = sizeof(uint64_t);
+    protocols_[0].rx_buffer_size = config_.rxBufferBytes;
+    protocols_[1] = {};
+
+    struct lws_context_creation_info info = {};
+    info.port = config_.port;
+    info.iface = config_.iface.empty() ? nullptr : config_.iface.c_str();
+    info.protocols = protocols_;
+    info.gid = -1;
+    info.uid = -1;
+    info.user = this;
+
+    context_ = lws_create_context(&info);
+    if (!context_) {
+        throw std::runtime_error("Failed to create loopback server context");
+    }
+    port_ = lws_get_vhost_listen_port(lws_get_vhost_by_name(context_, "default"));
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+}
+
+LoopbackServer::~LoopbackServer() {
+    running_ = false;
+    lws_cancel_service(context_);
+    thread_.join();
+    lws_context_destroy(context_);
+}
+
+void LoopbackServer::run() {
+    threadId_.store(std::this_thread::get_id());
+    pthread_setname_np(pthread_self(), "ws-loopback");
+    if (config_.onThreadStart) {
+        config_.onThreadStart();
+    }
+    while (running_) {
+        lws_service(context_, 0);
+    }
+}
+
+std::chrono::nanoseconds LoopbackServer::cpuTime() const {
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(const_cast<std::thread&>(thread_).native_handle(), &clock) != 0 ||
+        clock_gettime(clock, &ts) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+void LoopbackServer::send(uint64_t session, std::string_view payload, size_t fragmentBytes) {
+    Command command{session, Command::Kind::Send, Outgoing()};
+    command.message.buf.reserve(LWS_PRE + payload.size());
+    command.message.buf.assign(LWS_PRE, '\0');
+    command.message.buf.append(payload);
+    command.message.fragment = fragmentBytes;
+    queued_.fetch_add(1, std::memory_order_relaxed);
+
+    if (inServerThread()) {
+        apply(std::move(command));
+        return;
+    }
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex_);
+        wake = inbox_.empty();
+        inbox_.push_back(std::move(command));
+    }
+    // One wake-up per batch, the server drains the whole inbox
+    if (wake) {
+        lws_cancel_service(context_);
+    }
+}
+
+void LoopbackServer::close(uint64_t session) {
+    post(Command{session, Command::Kind::Close, Outgoing()});
+}
+
+void LoopbackServer::pauseReading(uint64_t session, bool paused) {
+    post(Command{session, paused ? Command::Kind::Pause : Command::Kind::Resume, Outgoing()});
+}
+
+void LoopbackServer::post(Command&& command) {
+    if (inServerThread()) {
+        apply(std::move(command));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex_);
+        inbox_.push_back(std::move(command));
+    }
+    lws_cancel_service(context_);
+}
+
+void LoopbackServer::apply(Command&& command) {
+    auto it = sessions_.find(command.session);
+    if (it == sessions_.end()) {
+        if (command.kind == Command::Kind::Send) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    Session& session = it->second;
+    switch (command.kind) {
+        case Command::Kind::Send:
+            session.queue.push_back(std::move(command.message));
+            break;
+        case Command::Kind::Close:
+            session.closing = true;
+            break;
+        case Command::Kind::Pause:
+        case Command::Kind::Resume:
+            lws_rx_flow_control(session.wsi, command.kind == Command::Kind::Resume);
+            return;
+    }
+    lws_callback_on_writable(session.wsi);
+}
+
+int LoopbackServer::writeQueued(Session& session) {
+    if (session.closing) {
+        return -1;
+    }
+
+    while (!session.queue.empty() && !lws_send_pipe_choked(session.wsi)) {
+        Outgoing& out = session.queue.front();
+        const size_t total = out.buf.size() - LWS_PRE;
+        const size_t chunk = out.fragment ? std::min(out.fragment, total - out.offset) : total;
+        const bool first = out.offset == 0;
+        const bool final = out.offset + chunk == total;
+
+        // Earlier fragments are on the wire, their bytes serve as headroom
+        auto* data = reinterpret_cast<unsigned char*>(&out.buf[LWS_PRE + out.offset]);
+        const int flags = lws_write_ws_flags(LWS_WRITE_TEXT, first, final);
+        if (lws_write(session.wsi, data, chunk, static_cast<enum lws_write_protocol>(flags)) < 0) {
+            return -1;
+        }
+        out.offset += chunk;
+        if (final) {
+            session.queue.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            txMessages_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!session.queue.empty()) {
+        lws_callback_on_writable(session.wsi);
+    }
+    return 0;
+}
+
+int LoopbackServer::callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len) {
+    struct lws_context* context = lws_get_context(wsi);
+    auto* server = context ? static_cast<LoopbackServer*>(lws_context_user(context)) : nullptr;
+    if (!server) {
+        return 0;
+    }
+    auto* id = static_cast<uint64_t*>(user);
+
+    switch (reason) {
+        case LWS_CALLBACK_ESTABLISHED: {
+            *id = server->nextSession_++;
+            server->sessions_[*id].wsi = wsi;
+            server->sessionCount_.fetch_add(1, std::memory_order_relaxed);
+            if (server->connectFn_) {
+                server->connectFn_(*id);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_RECEIVE: {
+            auto it = server->sessions_.find(*id);
+            if (it == server->sessions_.end()) {
+                break;
+            }
+            std::string& partial = it->second.partial;
+            partial.append(static_cast<const char*>(in), len);
+            if (lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0) {
+                server->rxMessages_.fetch_add(1, std::memory_order_relaxed);
+                if (server->messageFn_) {
+                    server->messageFn_(*id, partial);
+                }
+                // The callback may have closed the session
+                it = server->sessions_.find(*id);
+                if (it != server->sessions_.end()) {
+                    it->second.partial.clear();
+                }
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_SERVER_WRITEABLE: {
+            auto it = server->sessions_.find(*id);
+            if (it != server->sessions_.end()) {
+                return server->writeQueued(it->second);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_CLOSED: {
+            auto it = server->sessions_.find(*id);
+            if (it != server->sessions_.end()) {
+                server->queued_.fetch_sub(it->second.queue.size(), std::memory_order_relaxed);
+                server->sessions_.erase(it);
+                server->sessionCount_.fetch_sub(1, std::memory_order_relaxed);
+                if (server->closeFn_) {
+                    server->closeFn_(*id);
+                }
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            std::vector<Command> commands;
+            {
+                std::lock_guard<std::mutex> lock(server->inboxMutex_);
+                commands.swap(server->inbox_);
+            }
+            for (auto& command : commands) {
+                server->apply(std::move(command));
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+} // namespace cexpp::util::wss::testing
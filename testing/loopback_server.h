@@ -0,0 +1,121 @@
+// loopback_server.h
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cexpp::util::wss::testing {
+
+struct LoopbackServerConfig {
+    // 0 picks a free port, see port()
+    int port{0};
+    std::string iface{"127.0.0.1"};
+    size_t rxBufferBytes{64 * 1024};
+    // Runs first on the server thread (e.g. to exclude it from accounting)
+    std::function<void()> onThreadStart;
+};
+
+// Plain ws:// server on its own lws_context and thread, for benchmarks and
+// tests of WsClient without a network. Sessions are numbered from 1.
+class LoopbackServer {
+public:
+    using MessageFn = std::function<void(uint64_t session, std::string_view msg)>;
+    using SessionFn = std::function<void(uint64_t session)>;
+
+    explicit LoopbackServer(const LoopbackServerConfig& config = LoopbackServerConfig());
+    ~LoopbackServer();
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    int port() const { return port_; }
+
+    // Callbacks run on the server thread; set them before clients connect
+    void onMessage(MessageFn fn) { messageFn_ = std::move(fn); }
+    void onConnect(SessionFn fn) { connectFn_ = std::move(fn); }
+    void onClose(SessionFn fn) { closeFn_ = std::move(fn); }
+
+    // Queue a text message, split into fragmentBytes frames when non-zero.
+    // Any thread; from the server thread it skips the hand-over.
+    void send(uint64_t session, std::string_view payload, size_t fragmentBytes = 0);
+    // Drop the connection without a close handshake
+    void close(uint64_t session);
+    // Stop or resume reading from the session; a paused session leaves the
+    // client's frames in the socket, like a slow server
+    void pauseReading(uint64_t session, bool paused);
+
+    // Messages queued and not yet written, over all sessions
+    size_t queued() const { return queued_.load(std::memory_order_relaxed); }
+    size_t sessions() const { return sessionCount_.load(std::memory_order_relaxed); }
+    uint64_t rxMessages() const { return rxMessages_.load(std::memory_order_relaxed); }
+    uint64_t txMessages() const { return txMessages_.load(std::memory_order_relaxed); }
+    // CPU time of the server thread so far
+    std::chrono::nanoseconds cpuTime() const;
+
+    bool inServerThread() const { return std::this_thread::get_id() == threadId_.load(); }
+
+private:
+    struct Outgoing {
+        std::string buf;  // LWS_PRE headroom, then the payload
+        size_t fragment{0};
+        size_t offset{0};
+    };
+
+    struct Session {
+        struct lws* wsi{nullptr};
+        std::deque<Outgoing> queue;
+        std::string partial;
+        bool closing{false};
+    };
+
+    struct Command {
+        enum class Kind { Send, Close, Pause, Resume };
+
+        uint64_t session;
+        Kind kind;
+        Outgoing message;
+    };
+
+    static int callback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len);
+    void apply(Command&& command);
+    void post(Command&& command);
+    int writeQueued(Session& session);
+    void run();
+
+    LoopbackServerConfig config_;
+    struct lws_protocols protocols_[2];
+    struct lws_context* context_{nullptr};
+    int port_{0};
+    std::thread thread_;
+    std::atomic<std::thread::id> threadId_{};
+    std::atomic<bool> running_{false};
+
+    // Server thread only
+    std::unordered_map<uint64_t, Session> sessions_;
+    uint64_t nextSession_{1};
+    MessageFn messageFn_;
+    SessionFn connectFn_;
+    SessionFn closeFn_;
+
+    // Commands from other threads
+    std::mutex inboxMutex_;
+    std::vector<Command> inbox_;
+
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> sessionCount_{0};
+    std::atomic<uint64_t> rxMessages_{0};
+    std::atomic<uint64_t> txMessages_{0};
+};
+
+} // namespace cexpp::util::wss::testing
@@ -0,0 +1,224 @@
+// mock_exchange.cpp
+#include <mock_exchange.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <utility>
+
+namespace cexpp::util::wss::testing {
+
+MockExchange::MockExchange(const MockExchangeScript& script, const LoopbackServerConfig& config)
+    : script_(script)
+    , server_(config) {
+    server_.onConnect([this](uint64_t session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_[session];
+        newest_ = session;
+        stats_.connections++;
+    });
+    server_.onClose([this](uint64_t session) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.erase(session);
+    });
+    server_.onMessage([this](uint64_t session, std::string_view msg) { onMessage(session, msg); });
+    thread_ = std::thread([this]() { run(); });
+}
+
+MockExchange::~MockExchange() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void MockExchange::setScript(const MockExchangeScript& script) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        script_ = script;
+        nextUpdate_ = std::chrono::steady_clock::now();
+    }
+    cv_.notify_one();
+}
+
+void MockExchange::closeAll() {
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [id, state] : sessions_) {
+            ids.push_back(id);
+        }
+        stats_.closes += ids.size();
+    }
+    for (uint64_t id : ids) {
+        server_.close(id);
+    }
+}
+
+std::set<std::string> MockExchange::subscriptions(uint64_t session) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(session ? session : newest_);
+    return it == sessions_.end() ? std::set<std::string>() : it->second.streams;
+}
+
+MockExchangeStats MockExchange::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MockExchange::at(std::chrono::steady_clock::duration delay, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        actions_.emplace(std::chrono::steady_clock::now() + delay, std::move(fn));
+    }
+    cv_.notify_one();
+}
+
+void MockExchange::onMessage(uint64_t session, std::string_view msg) {
+    const nlohmann::json request = nlohmann::json::parse(msg, nullptr, false);
+    if (request.is_discarded() || !request.is_object() || !request.contains("method")) {
+        return;
+    }
+    const std::string method = request["method"].is_string() ? request["method"].get<std::string>() : "";
+    if (method != "SUBSCRIBE" && method != "UNSUBSCRIBE") {
+        return;
+    }
+    std::vector<std::string> params;
+    if (request.contains("params") && request["params"].is_array()) {
+        for (const auto& param : request["params"]) {
+            if (param.is_string()) {
+                params.push_back(param.get<std::string>());
+            }
+        }
+    }
+
+    std::string ack;
+    std::chrono::milliseconds ackDelay;
+    std::chrono::milliseconds readStall;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.requests++;
+        ackDelay = script_.ackDelay;
+        readStall = script_.readStall;
+
+        if (script_.dropAcks > 0) {
+            script_.dropAcks--;
+            stats_.dropped++;
+        } else {
+            bool rejected = false;
+            for (const auto& stream : params) {
+                rejected = rejected || script_.rejectStreams.count(stream) > 0;
+            }
+            nlohmann::json response;
+            if (rejected) {
+                response["error"] = {{"code", 2}, {"msg", "Invalid request"}};
+                stats_.errors++;
+            } else {
+                auto& streams = sessions_[session].streams;
+                for (const auto& stream : params) {
+                    if (method == "SUBSCRIBE") {
+                        streams.insert(stream);
+                    } else {
+                        streams.erase(stream);
+                    }
+                }
+                response["result"] = nullptr;
+                stats_.acks++;
+            }
+            response["id"] = request.contains("id") ? request["id"] : nlohmann::json();
+            ack = response.dump();
+        }
+    }
+
+    if (!ack.empty()) {
+        if (ackDelay.count() > 0) {
+            at(ackDelay, [this, session, ack]() { server_.send(session, ack); });
+        } else {
+            server_.send(session, ack);
+        }
+    }
+    if (readStall.count() > 0) {
+        server_.pauseReading(session, true);
+        at(readStall, [this, session]() { server_.pauseReading(session, false); });
+    }
+}
+
+void MockExchange::sendUpdates() {
+    std::vector<std::pair<uint64_t, std::string>> updates;
+    std::vector<uint64_t> closes;
+    size_t fragmentBytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fragmentBytes = script_.fragmentBytes;
+        const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        for (auto& [id, state] : sessions_) {
+            for (const auto& stream : state.streams) {
+                std::string update = "{\"stream\":\"" + stream + "\",\"data\":{\"e\":\"update\",\"E\":" +
+                                     std::to_string(now) + ",\"s\":\"" + stream + "\",\"u\":" +
+                                     std::to_string(++updateSeq_) + ",\"pad\":\"";
+                if (update.size() + 3 < script_.updateBytes) {
+                    update.append(script_.updateBytes - update.size() - 3, 'x');
+                }
+                update += "\"}}";
+                updates.emplace_back(id, std::move(update));
+                state.updates++;
+                stats_.updates++;
+            }
+            if (script_.closeAfterUpdates && state.updates >= script_.closeAfterUpdates) {
+                state.updates = 0;
+                closes.push_back(id);
+                stats_.closes++;
+            }
+        }
+    }
+
+    for (auto& [id, update] : updates) {
+        server_.send(id, update, fragmentBytes);
+    }
+    for (uint64_t id : closes) {
+        server_.close(id);
+    }
+}
+
+void MockExchange::run() {
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        const auto now = Clock::now();
+        if (!actions_.empty() && actions_.begin()->first <= now) {
+            std::function<void()> fn = std::move(actions_.begin()->second);
+            actions_.erase(actions_.begin());
+            lock.unlock();
+            fn();
+            lock.lock();
+            continue;
+        }
+
+        const bool updating = script_.updateInterval.count() > 0;
+        if (updating && now >= nextUpdate_) {
+            // Keeps the rate, unless updates fall a whole interval behind
+            nextUpdate_ = std::max(nextUpdate_ + script_.updateInterval, now);
+            lock.unlock();
+            sendUpdates();
+            lock.lock();
+            continue;
+        }
+
+        Clock::time_point wake = Clock::time_point::max();
+        if (!actions_.empty()) {
+            wake = actions_.begin()->first;
+        }
+        if (updating) {
+            wake = std::min(wake, nextUpdate_);
+        }
+        if (wake == Clock::time_point::max()) {
+            cv_.wait(lock);
+        } else {
+            cv_.wait_until(lock, wake);
+        }
+    }
+}
+
+} // namespace cexpp::util::wss::testing
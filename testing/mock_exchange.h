@@ -0,0 +1,107 @@
+// mock_exchange.h
+
+#pragma once
+
+#include "loopback_server.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cexpp::util::wss::testing {
+
+// How the mock misbehaves. Can be replaced while clients are connected.
+struct MockExchangeScript {
+    // Every ack is sent this late
+    std::chrono::milliseconds ackDelay{0};
+    // The next dropAcks subscribe/unsubscribe requests get no ack at all
+    size_t dropAcks{0};
+    // Requests naming one of these streams get an error ack
+    std::set<std::string> rejectStreams;
+    // Server-initiated close of a session after it was sent this many
+    // updates, 0: never
+    uint64_t closeAfterUpdates{0};
+
+    // Market data: every subscribed stream gets an update of updateBytes
+    // each updateInterval (0: no updates), split into fragmentBytes frames
+    std::chrono::microseconds updateInterval{0};
+    size_t updateBytes{256};
+    size_t fragmentBytes{0};
+
+    // Slow reads: after each received message the session is not read for
+    // this long
+    std::chrono::milliseconds readStall{0};
+};
+
+struct MockExchangeStats {
+    uint64_t connections{0};  // sessions ever accepted
+    uint64_t requests{0};     // subscribe/unsubscribe frames received
+    uint64_t acks{0};
+    uint64_t errors{0};       // error acks
+    uint64_t dropped{0};      // requests left unanswered
+    uint64_t updates{0};
+    uint64_t closes{0};       // server-initiated
+};
+
+// In-process exchange speaking the Binance combined-stream protocol:
+// {"method":"SUBSCRIBE","params":[...],"id":N} is answered with
+// {"result":null,"id":N}, and subscribed streams receive
+// {"stream":name,"data":{"e":"update","E":ms,"s":name,"u":seq,...}}.
+// Delays, closes and updates run on a script thread of their own.
+class MockExchange {
+public:
+    explicit MockExchange(const MockExchangeScript& script = MockExchangeScript(),
+                          const LoopbackServerConfig& config = LoopbackServerConfig());
+    ~MockExchange();
+
+    MockExchange(const MockExchange&) = delete;
+    MockExchange& operator=(const MockExchange&) = delete;
+
+    int port() const { return server_.port(); }
+    LoopbackServer& server() { return server_; }
+
+    void setScript(const MockExchangeScript& script);
+    // Server-initiated close of every connected session
+    void closeAll();
+
+    // Streams the given session (0: the newest) is subscribed to
+    std::set<std::string> subscriptions(uint64_t session = 0) const;
+    size_t sessions() const { return server_.sessions(); }
+    MockExchangeStats stats() const;
+
+private:
+    struct SessionState {
+        std::set<std::string> streams;
+        uint64_t updates{0};
+    };
+
+    void onMessage(uint64_t session, std::string_view msg);
+    // Run fn on the script thread after delay
+    void at(std::chrono::steady_clock::duration delay, std::function<void()> fn);
+    void run();
+    void sendUpdates();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    MockExchangeScript script_;
+    std::map<uint64_t, SessionState> sessions_;
+    uint64_t newest_{0};
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> actions_;
+    std::chrono::steady_clock::time_point nextUpdate_{};
+    uint64_t updateSeq_{0};
+    MockExchangeStats stats_;
+    bool stopping_{false};
+    std::thread thread_;
+
+    // Last, so it is destroyed first: its service thread still runs the
+    // onClose callback, which needs the members above
+    LoopbackServer server_;
+};
+
+} // namespace cexpp::util::wss::testing
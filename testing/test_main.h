@@ -0,0 +1,50 @@
+// test_main.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace cexpp::util::wss::testing {
+
+// Failed CHECKs of the whole binary
+inline int failures = 0;
+
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+// Runs the test named by argv[1] (as CTest does), or all of them. Returns
+// the exit code: 0 when every CHECK held.
+template <size_t N>
+int runTests(int argc, char** argv, const TestCase (&tests)[N]) {
+    bool found = false;
+    for (const auto& test : tests) {
+        if (argc > 1 && std::strcmp(argv[1], test.name) != 0) {
+            continue;
+        }
+        found = true;
+        const int before = failures;
+        std::printf("[ RUN    ] %s\n", test.name);
+        test.fn();
+        std::printf("[ %s ] %s\n", failures == before ? "    OK" : "FAILED", test.name);
+    }
+    if (!found) {
+        std::printf("unknown test %s\n", argv[1]);
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
+
+} // namespace cexpp::util::wss::testing
+
+// Records a failure and goes on with the test
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);         \
+            ::cexpp::util::wss::testing::failures++;                                       \
+        }                                                                                  \
+    } while (0)
@@ -0,0 +1,190 @@
+// dns_cache_test.cpp
+//
+// Resolver cache: ranking, refresh and connect probes.
+// dns_cache_test [name] runs one test (as CTest does), or all of them.
+#include <dns_cache.h>
+#include <test_main.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace cexpp::util::wss;
+using namespace std::chrono_literals;
+
+static bool waitUntil(const std::function<bool()>& done, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// Resolver returning a list the test can change
+struct FakeResolver {
+    std::mutex mutex;
+    std::vector<std::string> addresses;
+    std::atomic<bool> fail{false};
+    std::atomic<int> calls{0};
+
+    void install(DnsCacheConfig& config) {
+        config.resolver = [this](const std::string&, uint16_t, std::vector<std::string>& out) {
+            calls++;
+            std::lock_guard<std::mutex> lock(mutex);
+            out = addresses;
+            return !fail;
+        };
+    }
+
+    void set(std::vector<std::string> next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        addresses = std::move(next);
+    }
+};
+
+static std::vector<std::string> lookup(DnsCache& cache, DnsStatus expected = DnsStatus::Resolved) {
+    std::vector<std::string> addresses;
+    CHECK(cache.lookup("edge.test", 443, addresses) == expected);
+    return addresses;
+}
+
+static void ranking() {
+    FakeResolver resolver;
+    resolver.set({"10.0.0.1", "10.0.0.2", "10.0.0.3"});
+    DnsCacheConfig config;
+    config.probe = false;
+    resolver.install(config);
+    DnsCache cache(config);
+
+    // Unmeasured: resolver order
+    CHECK(cache.resolve("edge.test", 443, 1000ms) == std::vector<std::string>({"10.0.0.1", "10.0.0.2", "10.0.0.3"}));
+
+    cache.recordHandshake("edge.test", 443, "10.0.0.2", 5ms);
+    cache.recordHandshake("edge.test", 443, "10.0.0.3", 1ms);
+    CHECK(lookup(cache) == std::vector<std::string>({"10.0.0.3", "10.0.0.2", "10.0.0.1"}));
+
+    // Failed addresses go last until they connect again
+    cache.recordFailure("edge.test", 443, "10.0.0.3");
+    CHECK(lookup(cache) == std::vector<std::string>({"10.0.0.2", "10.0.0.1", "10.0.0.3"}));
+    cache.recordHandshake("edge.test", 443, "10.0.0.3", 1ms);
+    CHECK(lookup(cache).front() == "10.0.0.3");
+
+    // Smoothed, not replaced: one slow handshake does not demote the fastest
+    cache.recordHandshake("edge.test", 443, "10.0.0.3", 9ms);
+    const auto stats = cache.endpointStats("edge.test", 443);
+    CHECK(stats.size() == 3);
+    CHECK(stats[0].address == "10.0.0.3" && stats[0].connects == 3 && stats[0].failures == 1);
+    CHECK(stats[0].handshakeRtt == 3ms);
+    CHECK(stats[1].address == "10.0.0.2" && stats[1].handshakeRtt == 5ms);
+    CHECK(stats[2].connects == 0 && stats[2].handshakeRtt.count() == 0);
+
+    // Addresses of other names are not touched
+    cache.recordFailure("other.test", 443, "10.0.0.2");
+    CHECK(resolver.calls == 1);
+}
+
+static void refresh() {
+    FakeResolver resolver;
+    resolver.set({"10.0.0.1", "10.0.0.2"});
+    DnsCacheConfig config;
+    config.probe = false;
+    config.ttl = 0s;
+    resolver.install(config);
+    DnsCache cache(config);
+
+    CHECK(cache.resolve("edge.test", 443, 1000ms).size() == 2);
+    cache.recordHandshake("edge.test", 443, "10.0.0.2", 2ms);
+
+    // Expired: the stale list is served at once while the refresh runs
+    resolver.set({"10.0.0.2", "10.0.0.4"});
+    CHECK(lookup(cache).size() == 2);
+    CHECK(waitUntil([&]() {
+        const auto addresses = lookup(cache);
+        return addresses == std::vector<std::string>({"10.0.0.2", "10.0.0.4"});
+    }, 1000ms));
+    // Addresses still behind the name keep their measurements
+    const auto stats = cache.endpointStats("edge.test", 443);
+    CHECK(stats.size() == 2 && stats[0].handshakeRtt == 2ms && stats[0].connects == 1);
+
+    // A failed refresh keeps the last good addresses
+    resolver.fail = true;
+    const int before = resolver.calls;
+    CHECK(waitUntil([&]() {
+        lookup(cache);
+        return resolver.calls > before;
+    }, 1000ms));
+    std::this_thread::sleep_for(50ms);
+    CHECK(lookup(cache).size() == 2);
+}
+
+static void failedResolution() {
+    FakeResolver resolver;
+    resolver.fail = true;
+    DnsCacheConfig config;
+    config.probe = false;
+    config.failedTtl = 3600s;
+    resolver.install(config);
+    DnsCache cache(config);
+
+    lookup(cache, DnsStatus::Pending);
+    CHECK(cache.resolve("edge.test", 443, 1000ms).empty());
+    lookup(cache, DnsStatus::Failed);
+    // Not retried before failedTtl
+    CHECK(resolver.calls == 1);
+}
+
+static void probe() {
+    // A listener on 127.0.0.1 only: 127.0.0.2 refuses the same port
+    const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    CHECK(::bind(listener, reinterpret_cast<sockaddr*>(&addr), len) == 0);
+    CHECK(::listen(listener, 16) == 0);
+    CHECK(::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == 0);
+    const uint16_t port = ntohs(addr.sin_port);
+
+    FakeResolver resolver;
+    resolver.set({"127.0.0.2", "not-an-address", "127.0.0.1"});
+    DnsCacheConfig config;
+    config.probeTimeout = 2000ms;
+    resolver.install(config);
+    DnsCache cache(config);
+
+    CHECK(cache.resolve("local.test", port, 1000ms).size() == 3);
+    CHECK(waitUntil([&]() {
+        const auto stats = cache.endpointStats("local.test", port);
+        return !stats.empty() && stats[0].connectRtt.count() > 0;
+    }, 3000ms));
+    const auto stats = cache.endpointStats("local.test", port);
+    CHECK(stats.size() == 3);
+    if (stats.size() == 3) {
+        CHECK(stats[0].address == "127.0.0.1" && stats[0].failures == 0);
+        CHECK(stats[0].connectRtt < 1s);
+        CHECK(stats[1].failures == 1 && stats[2].failures == 1);
+        CHECK(stats[1].connectRtt.count() == 0);
+    }
+    ::close(listener);
+}
+
+static const testing::TestCase tests[] = {
+    {"ranking", ranking},
+    {"refresh", refresh},
+    {"failed_resolution", failedResolution},
+    {"probe", probe},
+};
+
+int main(int argc, char** argv) {
+    return testing::runTests(argc, argv, tests);
+}
@@ -0,0 +1,92 @@
+// feed_dedup_test.cpp
+//
+// First-arrival filter of redundant connections.
+// feed_dedup_test [name] runs one test (as CTest does), or all of them.
+#include <feed_dedup.h>
+#include <test_main.h>
+#include <string>
+
+using namespace cexpp::util::wss;
+
+static std::string depth(uint64_t id) {
+    return "{\"e\":\"depthUpdate\",\"E\":1700000000000,\"s\":\"BTCUSDT\",\"U\":" + std::to_string(id) +
+           ",\"u\":" + std::to_string(id) + ",\"b\":[],\"a\":[]}";
+}
+
+static void secondLeg() {
+    FeedDeduplicator dedup(2);
+    CHECK(dedup.firstArrival(0, "btcusdt@depth", depth(1)));
+    CHECK(!dedup.firstArrival(1, "btcusdt@depth", depth(1)));
+    // The other leg may win the next one
+    CHECK(dedup.firstArrival(1, "btcusdt@depth", depth(2)));
+    CHECK(!dedup.firstArrival(0, "btcusdt@depth", depth(2)));
+    // Same id on another stream is another update
+    CHECK(dedup.firstArrival(0, "ethusdt@depth", depth(1)));
+
+    // Frames without an id are matched by content
+    const std::string ack = R"({"result":null,"id":7})";
+    CHECK(dedup.firstArrival(1, "ack", ack));
+    CHECK(!dedup.firstArrival(0, "ack", ack));
+
+    const auto stats = dedup.stats();
+    CHECK(stats.size() == 2);
+    CHECK(stats[0].wins == 2 && stats[0].losses == 2 && stats[0].hashed == 1);
+    CHECK(stats[1].wins == 2 && stats[1].losses == 1 && stats[1].hashed == 1);
+
+    dedup.clear();
+    CHECK(dedup.firstArrival(1, "btcusdt@depth", depth(1)));
+}
+
+static void distinctIds() {
+    FeedDeduplicator dedup(2);
+    // Two fills of one order share the seller order id "a" but not "t"
+    const std::string trade1 =
+        R"({"e":"trade","E":1700000000000,"s":"BTCUSDT","t":100,"p":"1","q":"1","b":88,"a":50,"T":1})";
+    const std::string trade2 =
+        R"({"e":"trade","E":1700000000000,"s":"BTCUSDT","t":101,"p":"1","q":"2","b":89,"a":50,"T":1})";
+    CHECK(dedup.firstArrival(0, "btcusdt@trade", trade1));
+    CHECK(dedup.firstArrival(0, "btcusdt@trade", trade2));
+    CHECK(!dedup.firstArrival(1, "btcusdt@trade", trade2));
+
+    // Aggregate trades carry only "a"
+    const std::string agg1 = R"({"e":"aggTrade","E":1700000000000,"s":"BTCUSDT","a":5,"f":100,"l":101})";
+    const std::string agg2 = R"({"e":"aggTrade","E":1700000000000,"s":"BTCUSDT","a":6,"f":102,"l":102})";
+    CHECK(dedup.firstArrival(0, "btcusdt@aggTrade", agg1));
+    CHECK(dedup.firstArrival(0, "btcusdt@aggTrade", agg2));
+    CHECK(!dedup.firstArrival(1, "btcusdt@aggTrade", agg1));
+
+    // Kline updates repeat the candle's "t", the event time tells them apart
+    const std::string kline1 = R"({"e":"kline","E":1700000000000,"s":"BTCUSDT","k":{"t":1699999980000}})";
+    const std::string kline2 = R"({"e":"kline","E":1700000002000,"s":"BTCUSDT","k":{"t":1699999980000}})";
+    CHECK(dedup.firstArrival(0, "btcusdt@kline_1m", kline1));
+    CHECK(dedup.firstArrival(0, "btcusdt@kline_1m", kline2));
+    CHECK(!dedup.firstArrival(1, "btcusdt@kline_1m", kline2));
+}
+
+static void windowWrap() {
+    FeedDedupConfig config;
+    config.window = 4;
+    FeedDeduplicator dedup(2, config);
+    for (uint64_t id = 1; id <= 10; ++id) {
+        CHECK(dedup.firstArrival(0, "btcusdt@depth", depth(id)));
+    }
+    // The last four are remembered across the wrap
+    for (uint64_t id = 7; id <= 10; ++id) {
+        CHECK(!dedup.firstArrival(1, "btcusdt@depth", depth(id)));
+    }
+    // Older ones have been overwritten and pass again
+    CHECK(dedup.firstArrival(1, "btcusdt@depth", depth(6)));
+    // ...evicting 7, the oldest
+    CHECK(dedup.firstArrival(1, "btcusdt@depth", depth(7)));
+    CHECK(!dedup.firstArrival(0, "btcusdt@depth", depth(10)));
+}
+
+static const testing::TestCase tests[] = {
+    {"second_leg", secondLeg},
+    {"distinct_ids", distinctIds},
+    {"window_wrap", windowWrap},
+};
+
+int main(int argc, char** argv) {
+    return testing::runTests(argc, argv, tests);
+}
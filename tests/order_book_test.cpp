@@ -0,0 +1,208 @@
+// order_book_test.cpp
+//
+// OrderBookSync fed with depth diffs, snapshots from a file.
+// order_book_test [name] runs one test (as CTest does), or all of them.
+#include <order_book.h>
+#include <test_main.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace cexpp::util::wss;
+
+static std::string snapshotPath() {
+    return "/tmp/order_book_test_" + std::to_string(getpid()) + "_{symbol}.json";
+}
+
+static void writeSnapshot(const std::string& symbol, const std::string& json) {
+    std::string path = snapshotPath();
+    path.replace(path.find("{symbol}"), 8, symbol);
+    std::ofstream(path) << json;
+}
+
+static std::string diff(uint64_t first, uint64_t last, const std::string& bids, const std::string& asks) {
+    return "{\"e\":\"depthUpdate\",\"E\":1,\"s\":\"BTCUSDT\",\"U\":" + std::to_string(first) +
+           ",\"u\":" + std::to_string(last) + ",\"b\":[" + bids + "],\"a\":[" + asks + "]}";
+}
+
+static OrderBookConfig config() {
+    OrderBookConfig config;
+    config.symbol = "BTCUSDT";
+    config.priceDecimals = 2;
+    config.quantityDecimals = 3;
+    config.snapshotRetry = std::chrono::milliseconds(0);
+    return config;
+}
+
+static void fixedPoint() {
+    int64_t v = 0;
+    CHECK(parseFixedPoint("27123.45000000", 2, v) && v == 2712345);
+    CHECK(parseFixedPoint("0.001", 3, v) && v == 1);
+    CHECK(parseFixedPoint("-0.5", 2, v) && v == -50);
+    CHECK(parseFixedPoint("42", 3, v) && v == 42000);
+    CHECK(parseFixedPoint(".5", 1, v) && v == 5);
+    CHECK(!parseFixedPoint("0.001", 2, v));  // below the resolution
+    CHECK(!parseFixedPoint("1e-3", 3, v));
+    CHECK(!parseFixedPoint("", 2, v));
+    CHECK(!parseFixedPoint("-", 2, v));
+    CHECK(!parseFixedPoint("1.2.3", 2, v));
+    CHECK(!parseFixedPoint("92233720368547758.08", 2, v));  // overflow
+}
+
+static void ladder() {
+    BookLadder bids(BookSide::Bid);
+    BookLadder asks(BookSide::Ask);
+    for (int64_t p : {100, 103, 101, 99, 102}) {
+        bids.apply(p, 1, 4);
+        asks.apply(p + 10, 1, 4);
+    }
+    // Worst levels dropped past maxLevels
+    CHECK(bids.size() == 4 && bids.best().price == 103 && bids.level(3).price == 100);
+    CHECK(asks.size() == 4 && asks.best().price == 109 && asks.level(3).price == 112);
+    CHECK(bids.quantityAt(99) == 0);
+
+    bids.apply(103, 0, 4);
+    CHECK(bids.best().price == 102);
+    CHECK(!bids.apply(500, 0, 4));
+    bids.apply(101, 7, 4);
+    CHECK(bids.quantityAt(101) == 7 && bids.size() == 3);
+}
+
+static void snapshotSync() {
+    writeSnapshot("BTCUSDT", R"({"lastUpdateId":100,"bids":[["100.00","1.000"],["99.00","2.000"]],)"
+                             R"("asks":[["101.00","1.500"],["102.00","3.000"]]})");
+    OrderBookSync book(config(), std::make_shared<FileSnapshotSource>(snapshotPath()));
+    int updates = 0;
+    book.setUpdateCallback([&](const OrderBookSync&) { updates++; });
+
+    // The first diff triggers the snapshot: it is covered, so dropped
+    CHECK(book.onDepthMessage(diff(95, 99, R"(["100.00","9.000"])", "")));
+    CHECK(book.state() == BookState::Live);
+    CHECK(book.lastUpdateId() == 100);
+    CHECK(book.bids().quantityAt(10000) == 1000);
+
+    // Straddles 101, then follows on
+    CHECK(book.onDepthMessage(diff(99, 102, R"(["100.50","0.500"])", R"(["101.00","0.000"])")));
+    CHECK(book.onDepthMessage("{\"stream\":\"btcusdt@depth\",\"data\":" +
+                              diff(103, 105, "", R"(["100.75","0.250"])") + "}"));
+    CHECK(book.lastUpdateId() == 105);
+
+    const TopOfBook top = book.top();
+    CHECK(top.bid.price == 10050 && top.bid.quantity == 500);
+    CHECK(top.ask.price == 10075 && top.ask.quantity == 250);
+    CHECK(top.updateId == 105);
+    CHECK(book.price(top.bid.price) == 100.5);
+    CHECK(book.asks().size() == 2);
+
+    // Already applied, like the first diff the snapshot covered
+    CHECK(book.onDepthMessage(diff(104, 105, "", "")));
+    CHECK(book.stats().stale == 2);
+    CHECK(book.stats().diffs == 2);
+    CHECK(updates == 3);
+    CHECK(!book.onDepthMessage(R"({"U":1})"));
+    CHECK(book.stats().rejected == 1);
+}
+
+static void gapResync() {
+    writeSnapshot("GAP", R"({"lastUpdateId":10,"bids":[["50.00","1.000"]],"asks":[["51.00","1.000"]]})");
+    OrderBookConfig cfg = config();
+    cfg.symbol = "GAP";
+    cfg.snapshotRetry = std::chrono::milliseconds(50);
+    OrderBookSync book(cfg, std::make_shared<FileSnapshotSource>(snapshotPath()));
+
+    CHECK(book.onDepthMessage(diff(9, 11, "", "")));
+    CHECK(book.state() == BookState::Live && book.lastUpdateId() == 11);
+
+    // 12..13 lost. The new snapshot is older than the diff that found the
+    // gap, so the book stays out of sync, and the next fetch waits for
+    // snapshotRetry instead of getting the same snapshot again.
+    writeSnapshot("GAP", R"({"lastUpdateId":12,"bids":[["49.00","1.000"]],"asks":[["51.00","1.000"]]})");
+    CHECK(book.onDepthMessage(diff(14, 15, R"(["50.00","0.000"])", "")));
+    CHECK(book.stats().gaps == 2);
+    CHECK(book.state() == BookState::Syncing);
+    CHECK(book.top().updateId == 0);
+
+    writeSnapshot("GAP", R"({"lastUpdateId":15,"bids":[["49.00","1.000"]],"asks":[["51.00","1.000"]]})");
+    CHECK(book.onDepthMessage(diff(16, 16, R"(["49.50","2.000"])", "")));
+    CHECK(book.state() == BookState::Syncing);
+    CHECK(book.stats().snapshots == 2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    CHECK(book.onDepthMessage(diff(17, 17, "", "")));
+    CHECK(book.state() == BookState::Live && book.lastUpdateId() == 17);
+    CHECK(book.top().bid.price == 4950);
+    CHECK(book.bids().quantityAt(5000) == 0);
+    CHECK(book.stats().snapshots == 3);
+}
+
+static void futuresPreviousId() {
+    writeSnapshot("PERP", R"({"lastUpdateId":1000,"bids":[["10.00","1.000"]],"asks":[["11.00","1.000"]]})");
+    OrderBookConfig cfg = config();
+    cfg.symbol = "PERP";
+    OrderBookSync book(cfg, std::make_shared<FileSnapshotSource>(snapshotPath()));
+
+    // Futures ids are not consecutive: pu links each diff to the last
+    auto perp = [](uint64_t first, uint64_t last, uint64_t previous) {
+        return "{\"e\":\"depthUpdate\",\"U\":" + std::to_string(first) + ",\"u\":" + std::to_string(last) +
+               ",\"pu\":" + std::to_string(previous) + ",\"b\":[],\"a\":[]}";
+    };
+    CHECK(book.onDepthMessage(perp(990, 1005, 980)));
+    CHECK(book.onDepthMessage(perp(1010, 1020, 1005)));
+    CHECK(book.state() == BookState::Live && book.lastUpdateId() == 1020);
+    // 1021..1029 lost, and the snapshot at 1000 cannot bridge it either
+    CHECK(book.onDepthMessage(perp(1030, 1040, 1025)));
+    CHECK(book.stats().gaps == 2);
+    CHECK(book.state() == BookState::Syncing);
+
+    // The diff ending at the snapshot is stale; the next one starts past it
+    // but its pu is the snapshot id
+    OrderBookSync linked(cfg, std::make_shared<FileSnapshotSource>(snapshotPath()));
+    CHECK(linked.onDepthMessage(perp(990, 1000, 985)));
+    CHECK(linked.onDepthMessage(perp(1004, 1010, 1000)));
+    CHECK(linked.state() == BookState::Live && linked.lastUpdateId() == 1010);
+    CHECK(linked.stats().gaps == 0);
+}
+
+static void failedSnapshot() {
+    OrderBookConfig cfg = config();
+    cfg.symbol = "MISSING";
+    cfg.maxBufferedDiffs = 3;
+    OrderBookSync book(cfg, std::make_shared<FileSnapshotSource>("/nonexistent/{symbol}.json"));
+    for (uint64_t id = 1; id <= 5; ++id) {
+        CHECK(book.onDepthMessage(diff(id, id, "", "")));
+    }
+    CHECK(book.state() == BookState::Syncing);
+    CHECK(book.stats().buffered == 5);
+    CHECK(book.stats().snapshots == 5);
+
+    // Only the newest three are kept; a snapshot at 1 leaves a hole
+    book.onSnapshot(true, DepthSnapshot{1, {{100, 1}}, {{200, 1}}});
+    CHECK(book.onDepthMessage(diff(6, 6, "", "")));
+    CHECK(book.state() == BookState::Syncing);
+    book.onSnapshot(true, DepthSnapshot{3, {{100, 1}}, {{200, 1}}});
+    CHECK(book.onDepthMessage(diff(7, 7, "", "")));
+    CHECK(book.state() == BookState::Live && book.lastUpdateId() == 7);
+}
+
+static const testing::TestCase tests[] = {
+    {"fixed_point", fixedPoint},
+    {"ladder", ladder},
+    {"snapshot_sync", snapshotSync},
+    {"gap_resync", gapResync},
+    {"futures_previous_id", futuresPreviousId},
+    {"failed_snapshot", failedSnapshot},
+};
+
+int main(int argc, char** argv) {
+    const int result = testing::runTests(argc, argv, tests);
+    for (const char* symbol : {"BTCUSDT", "GAP", "PERP"}) {
+        std::string path = snapshotPath();
+        path.replace(path.find("{symbol}"), 8, symbol);
+        std::remove(path.c_str());
+    }
+    return result;
+}
@@ -0,0 +1,215 @@
+// typed_messages_test.cpp
+//
+// Schema decoders and the decimal parsers.
+// typed_messages_test [name] runs one test (as CTest does), or all of them.
+#include <typed_messages.h>
+#include <test_main.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cexpp::util::wss;
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+static const std::string tradeFrame =
+    R"({"e":"trade","E":1700000000123,"s":"BTCUSDT","t":12345,"p":"27123.45000000",)"
+    R"("q":"0.00150000","T":1700000000120,"m":true,"M":true})";
+static const std::string bookTickerFrame =
+    R"({"stream":"btcusdt@bookTicker","data":{"u":400900217,"s":"BTCUSDT","b":"25.35190000",)"
+    R"("B":"31.21000000","a":"25.36520000","A":"40.66000000"}})";
+static const std::string depthFrame =
+    R"({"e":"depthUpdate","E":123456789,"s":"BNBBTC","U":157,"u":160,)"
+    R"("b":[["0.0024","10"],["0.0023","0"]],"a":[["0.0026","100.5"]]})";
+
+static void decimal() {
+    double v = 0;
+    CHECK(parseDecimal("27123.45", v) && v == 27123.45);
+    CHECK(parseDecimal("0.00150000", v) && v == 0.0015);
+    CHECK(parseDecimal("-12.5", v) && v == -12.5);
+    CHECK(parseDecimal("42", v) && v == 42.0);
+    CHECK(parseDecimal("1e-3", v) && v == 0.001);
+    CHECK(parseDecimal("123456789012345678901234", v) && v == 123456789012345678901234.0);
+    CHECK(parseDecimal("0.000000000000000000000000123", v) && v == 1.23e-25);
+    CHECK(!parseDecimal("", v));
+    CHECK(!parseDecimal("-", v));
+    CHECK(!parseDecimal("1.2.3", v));
+    CHECK(!parseDecimal("12a", v));
+
+    // Same double as strtod for prices of every magnitude
+    std::mt19937_64 rng(7);
+    int mismatches = 0;
+    for (int i = 0; i < 100000; ++i) {
+        char text[64];
+        const int decimals = static_cast<int>(rng() % 9);
+        std::snprintf(text, sizeof(text), "%.*f", decimals,
+                      static_cast<double>(rng() % 100000000) / static_cast<double>(1 + rng() % 10000));
+        mismatches += !parseDecimal(text, v) || v != std::strtod(text, nullptr);
+    }
+    CHECK(mismatches == 0);
+
+    int64_t fixed = 0;
+    CHECK(parseFixedPoint("27123.45000000", 2, fixed) && fixed == 2712345);
+    CHECK(!parseFixedPoint("0.001", 2, fixed));
+}
+
+static void trade() {
+    TypedDispatcher<Trade> handler;
+    Trade got;
+    int calls = 0;
+    handler.on<Trade>([&](const Trade& t) {
+        got = t;
+        calls++;
+    });
+    CHECK(handler.onFrame(tradeFrame));
+    CHECK(calls == 1);
+    CHECK(got.eventTime == 1700000000123 && got.tradeTime == 1700000000120);
+    CHECK(got.tradeId == 12345);
+    CHECK(got.price == 27123.45 && got.quantity == 0.0015);
+    CHECK(got.buyerIsMaker);
+    CHECK(handler.rejected() == 0);
+
+    // Wrong type for a bound member
+    CHECK(!handler.onFrame(R"({"e":"trade","t":"abc"})"));
+    CHECK(handler.rejected() == 1 && calls == 1);
+
+    // Acks and other events are not trades
+    CHECK(!handler.onFrame(R"({"result":null,"id":1})"));
+    CHECK(!handler.onFrame(R"({"e":"aggTrade","a":1})"));
+    CHECK(handler.unmatched() == 2 && calls == 1);
+}
+
+static void scanner() {
+    // Blanks, escapes and nested values in members nobody binds
+    TypedDispatcher<Trade> handler;
+    Trade got;
+    handler.on<Trade>([&](const Trade& t) { got = t; });
+    CHECK(handler.onFrame(" { \"e\" : \"trade\" , \"x\":{\"a\":[1,\"}\\\"]\\\\\"]},\n"
+                          "\"s\":\"ETHUSDT\",\t\"p\" : 1.5 , \"m\":false } "));
+    CHECK(got.symbol == "ETHUSDT" && got.price == 1.5 && !got.buyerIsMaker);
+
+    // Escaped strings cannot be viewed in place
+    CHECK(!handler.onFrame(R"({"e":"trade","s":"A\"B"})"));
+    CHECK(!handler.onFrame(R"({"e":"trade","p":"1"x})"));
+    CHECK(!handler.onFrame(R"({"e":"trade","x":[1,2})"));
+    CHECK(handler.rejected() == 3);
+
+    int members = 0;
+    CHECK(forEachMember(R"({"a":{"b":[1,{"c":"]"}]},"d":null,"e":-1.5e3})",
+                        [&](std::string_view, const RawValue&) { return ++members > 0; }));
+    CHECK(members == 3);
+    CHECK(forEachMember("{}", [](std::string_view, const RawValue&) { return true; }));
+    CHECK(!forEachMember("[]", [](std::string_view, const RawValue&) { return true; }));
+}
+
+static void dispatch() {
+    TypedDispatcher<Trade, BookTicker, DepthUpdate, Ticker> handler;
+    int trades = 0;
+    int tickers = 0;
+    double bid = 0;
+    std::vector<std::pair<int64_t, int64_t>> bids;
+    double ask = 0;
+    handler.on<Trade>([&](const Trade&) { trades++; });
+    handler.on<Ticker>([&](const Ticker&) { tickers++; });
+    handler.on<BookTicker>([&](const BookTicker& b) {
+        CHECK(b.symbol == "BTCUSDT" && b.updateId == 400900217);
+        bid = b.bidPrice;
+    });
+    handler.on<DepthUpdate>([&](const DepthUpdate& d) {
+        CHECK(d.firstUpdateId == 157 && d.finalUpdateId == 160);
+        CHECK(d.bids.size() == 2 && !d.asks.empty());
+        CHECK(d.bids.forEach<Fixed<4>>([&](Fixed<4> p, Fixed<4> q) { bids.emplace_back(p.value, q.value); }));
+        CHECK(d.asks.forEach([&](double p, double q) { ask = p * q; }));
+    });
+
+    CHECK(handler.onFrame(tradeFrame));
+    CHECK(handler.onFrame(bookTickerFrame));
+    CHECK(handler.onFrame(depthFrame));
+    CHECK(trades == 1 && tickers == 0);
+    CHECK(bid == 25.3519);
+    CHECK(bids.size() == 2 && bids[0] == std::make_pair(int64_t{24}, int64_t{100000}) && bids[1].second == 0);
+    CHECK(ask == 0.0026 * 100.5);
+
+    CHECK(!handler.onFrame(R"({"e":"kline","E":1})"));
+    CHECK(handler.unmatched() == 1);
+    CHECK(!handler.onFrame("{\"e\":"));
+    CHECK(handler.rejected() == 1);
+
+    // No "e" and no "u": a subscribe ack, not a book ticker
+    bid = 0;
+    CHECK(!handler.onFrame(R"({"result":null,"id":1})"));
+    CHECK(!handler.onFrame(R"({"stream":"btcusdt@bookTicker","data":{"id":2}})"));
+    CHECK(handler.unmatched() == 3 && handler.rejected() == 1);
+    CHECK(bid == 0);
+}
+
+static void ticker() {
+    TypedDispatcher<Ticker> handler;
+    Ticker got;
+    handler.on<Ticker>([&](const Ticker& t) { got = t; });
+    CHECK(handler.onFrame(R"({"e":"24hrTicker","E":123456789,"s":"BNBBTC","p":"0.0015","P":"250.00",)"
+                          R"("w":"0.0018","x":"0.0009","c":"0.0025","Q":"10","b":"0.0024","B":"10",)"
+                          R"("a":"0.0026","A":"100","o":"0.0010","h":"0.0025","l":"0.0010","v":"10000",)"
+                          R"("q":"18","O":0,"C":86400000,"F":0,"L":18150,"n":18151})"));
+    CHECK(got.symbol == "BNBBTC");
+    CHECK(got.lastPrice == 0.0025 && got.priceChangePercent == 250.0);
+    CHECK(got.bidPrice == 0.0024 && got.askQuantity == 100.0);
+    CHECK(got.volume == 10000.0 && got.quoteVolume == 18.0);
+    CHECK(got.tradeCount == 18151);
+}
+
+static void noAllocation() {
+    TypedDispatcher<Trade, BookTicker, DepthUpdate> handler;
+    double sum = 0;
+    handler.on<Trade>([&](const Trade& t) { sum += t.price; });
+    handler.on<BookTicker>([&](const BookTicker& b) { sum += b.askPrice; });
+    handler.on<DepthUpdate>([&](const DepthUpdate& d) {
+        d.bids.forEach([&](double p, double q) { sum += p * q; });
+    });
+    // The first frames grow the index
+    handler.onFrame(depthFrame);
+    handler.onFrame(bookTickerFrame);
+
+    const uint64_t before = allocations.load();
+    for (int i = 0; i < 1000; ++i) {
+        handler.onFrame(tradeFrame);
+        handler.onFrame(bookTickerFrame);
+        handler.onFrame(depthFrame);
+    }
+    CHECK(allocations.load() == before);
+    CHECK(sum > 0);
+}
+
+static const testing::TestCase tests[] = {
+    {"decimal", decimal},
+    {"trade", trade},
+    {"scanner", scanner},
+    {"dispatch", dispatch},
+    {"ticker", ticker},
+    {"no_allocation", noAllocation},
+};
+
+int main(int argc, char** argv) {
+    return testing::runTests(argc, argv, tests);
+}
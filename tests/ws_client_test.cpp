@@ -0,0 +1,381 @@
+// ws_client_test.cpp
+//
+// End-to-end tests of WsClient against the in-process MockExchange.
+// ws_client_test [name] runs one test (as CTest does), or all of them.
+#include <ws_client.h>
+#include <mock_exchange.h>
+#include <test_main.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cexpp::util::wss;
+using namespace std::chrono_literals;
+using testing::MockExchange;
+using testing::MockExchangeScript;
+
+static bool waitUntil(const std::function<bool()>& done, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+static double ms(std::chrono::nanoseconds d) {
+    return static_cast<double>(d.count()) / 1e6;
+}
+
+// Counts updates per stream, Binance-style subscribe payloads
+class TestHandler : public IClientHandler {
+public:
+    void onUpdate() override {}
+    void onMessage(const nlohmann::json&) override {}
+    void onMessage(const std::string&) override {}
+    ParseMode parseMode() const override { return ParseMode::Raw; }
+
+    bool onRawMessage(std::string_view msg) override {
+        static constexpr std::string_view key = "{\"stream\":\"";
+        if (msg.substr(0, key.size()) != key) {
+            return true;  // acks
+        }
+        const size_t end = msg.find('"', key.size());
+        std::lock_guard<std::mutex> lock(mutex_);
+        counts_[std::string(msg.substr(key.size(), end - key.size()))]++;
+        largest_ = std::max(largest_, msg.size());
+        intact_ = intact_ && msg.substr(msg.size() - 3) == "\"}}";
+        total_++;
+        return true;
+    }
+
+    std::string genSubscribePayload(const std::string& name, bool unSub) override {
+        return genBatchSubscribePayload({name}, unSub);
+    }
+
+    std::string genBatchSubscribePayload(const std::vector<std::string>& names, bool unSub) override {
+        nlohmann::json payload;
+        payload["method"] = unSub ? "UNSUBSCRIBE" : "SUBSCRIBE";
+        payload["params"] = names;
+        payload["id"] = nextId_++;
+        return payload.dump();
+    }
+
+    uint64_t count(const std::string& stream) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return counts_[stream];
+    }
+    uint64_t total() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return total_;
+    }
+    size_t largest() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return largest_;
+    }
+    bool intact() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return intact_;
+    }
+
+private:
+    std::atomic<uint64_t> nextId_{1};
+    std::mutex mutex_;
+    std::map<std::string, uint64_t> counts_;
+    uint64_t total_{0};
+    size_t largest_{0};
+    bool intact_{true};
+};
+
+static std::shared_ptr<WsClient> connectTo(MockExchange& exchange, TestHandler& handler) {
+    WsClientConfig config;
+    config.reconnectBaseDelay = 100ms;
+    config.reconnectMaxDelay = 1000ms;
+    auto client = std::make_shared<WsClient>(&handler, "127.0.0.1", "/", exchange.port(), false, config);
+    CHECK(waitUntil([&]() { return client->connectionState() == ConnectionState::Connected; }, 3000ms));
+    return client;
+}
+
+static bool allSubscribed(WsClient& client, const std::vector<std::string>& streams) {
+    for (const auto& stream : streams) {
+        if (!client.isSubscribeOk(stream)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void subscribeAck() {
+    MockExchangeScript script;
+    script.updateInterval = 5ms;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    const std::vector<std::string> streams{"btcusdt@trade", "ethusdt@trade", "bnbusdt@trade"};
+    for (const auto& stream : streams) {
+        client->subscribeDynamic(stream, "", true);
+    }
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 2000ms));
+    CHECK(client->subscribeStats().acked == streams.size());
+    CHECK(exchange.subscriptions() == std::set<std::string>(streams.begin(), streams.end()));
+    CHECK(waitUntil([&]() { return handler.count("bnbusdt@trade") > 10; }, 2000ms));
+}
+
+// A burst of one token leaves nothing to reserve: subscribes still go out
+static void rateBurstOne() {
+    MockExchange exchange;
+    TestHandler handler;
+    WsClientConfig config;
+    config.sendRateLimit = 20;
+    config.sendRateBurst = 1;
+    config.bulkLaneReserve = 1;
+    auto client = std::make_shared<WsClient>(&handler, "127.0.0.1", "/", exchange.port(), false, config);
+    CHECK(waitUntil([&]() { return client->connectionState() == ConnectionState::Connected; }, 3000ms));
+
+    const std::vector<std::string> streams{"btcusdt@trade", "ethusdt@trade", "bnbusdt@trade"};
+    for (const auto& stream : streams) {
+        client->subscribeDynamic(stream, "", true);
+    }
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 2000ms));
+    CHECK(exchange.subscriptions() == std::set<std::string>(streams.begin(), streams.end()));
+}
+
+static void ackDelay() {
+    MockExchangeScript script;
+    script.ackDelay = 150ms;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    client->subscribeDynamic("btcusdt@depth", "", true);
+    CHECK(!client->isSubscribeOk("btcusdt@depth"));
+    CHECK(waitUntil([&]() { return client->isSubscribeOk("btcusdt@depth"); }, 2000ms));
+    const auto latency = client->subscribeStats().lastAckLatency;
+    std::printf("  ack latency %.1f ms with a 150 ms ack delay\n", ms(latency));
+    CHECK(latency >= 150ms);
+    CHECK(latency < 400ms);
+}
+
+static void missingAckRetry() {
+    MockExchangeScript script;
+    script.dropAcks = 1;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    // The client retries an unanswered request after its retry interval
+    client->subscribeDynamic("btcusdt@trade", "", true);
+    CHECK(waitUntil([&]() { return client->isSubscribeOk("btcusdt@trade"); }, 10000ms));
+    CHECK(client->subscribeStats().retries >= 1);
+    CHECK(exchange.stats().dropped == 1);
+    CHECK(exchange.stats().acks == 1);
+}
+
+static void errorAck() {
+    MockExchangeScript script;
+    script.rejectStreams = {"nosuch@trade"};
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    client->subscribeDynamic("nosuch@trade", "", true);
+    CHECK(waitUntil([&]() { return client->subscribeStats().failed == 1; }, 2000ms));
+    CHECK(!client->isSubscribeOk("nosuch@trade"));
+    CHECK(client->subscribeStats().inFlight == 0);
+}
+
+static void reconnectResubscribe() {
+    MockExchangeScript script;
+    script.updateInterval = 5ms;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    std::vector<std::string> streams;
+    for (int i = 0; i < 10; ++i) {
+        streams.push_back("sym" + std::to_string(i) + "@bookTicker");
+    }
+    client->subscribeMany(streams, "", true);
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 2000ms));
+
+    exchange.closeAll();
+    CHECK(waitUntil([&]() { return client->reconnectStats().reconnects == 1; }, 3000ms));
+    const auto outage = client->reconnectStats().lastOutage;
+    std::printf("  reconnected after %.1f ms\n", ms(outage));
+    // 100 ms base delay with 20% jitter, plus a loopback handshake
+    CHECK(outage < 500ms);
+
+    // Everything is restored on the new session, and data flows again
+    CHECK(waitUntil([&]() {
+        return exchange.subscriptions() == std::set<std::string>(streams.begin(), streams.end());
+    }, 2000ms));
+    const uint64_t before = handler.count("sym9@bookTicker");
+    CHECK(waitUntil([&]() { return handler.count("sym9@bookTicker") > before + 10; }, 2000ms));
+    CHECK(exchange.stats().connections == 2);
+}
+
+// An unsubscribe lost with the connection is not undone by the restore
+static void reconnectPendingUnsubscribe() {
+    MockExchange exchange;
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    const std::vector<std::string> streams{"btcusdt@trade", "ethusdt@trade"};
+    client->subscribeMany(streams, "", true);
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 2000ms));
+
+    MockExchangeScript script;
+    script.dropAcks = 1;
+    exchange.setScript(script);
+    client->unSubscribeDynamic("btcusdt@trade", "", true);
+    CHECK(waitUntil([&]() { return exchange.stats().dropped == 1; }, 2000ms));
+
+    exchange.closeAll();
+    CHECK(waitUntil([&]() { return client->reconnectStats().reconnects == 1; }, 3000ms));
+    CHECK(waitUntil([&]() { return client->isUnsubscribeOk("btcusdt@trade"); }, 2000ms));
+    CHECK(waitUntil([&]() { return exchange.subscriptions() == std::set<std::string>{"ethusdt@trade"}; }, 2000ms));
+    CHECK(client->isSubscribeOk("ethusdt@trade"));
+}
+
+static void repeatedServerClose() {
+    MockExchangeScript script;
+    script.updateInterval = 2ms;
+    script.closeAfterUpdates = 50;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    client->subscribeDynamic("btcusdt@trade", "", true);
+    CHECK(waitUntil([&]() { return client->reconnectStats().reconnects >= 3; }, 5000ms));
+    CHECK(waitUntil([&]() { return exchange.subscriptions() == std::set<std::string>{"btcusdt@trade"}; }, 2000ms));
+    std::printf("  %lu reconnects, max outage %.1f ms\n",
+                static_cast<unsigned long>(client->reconnectStats().reconnects),
+                ms(client->reconnectStats().maxOutage));
+}
+
+static void fragmentedFrames() {
+    MockExchangeScript script;
+    script.updateInterval = 5ms;
+    script.updateBytes = 256 * 1024;
+    script.fragmentBytes = 1000;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    client->subscribeDynamic("btcusdt@depth", "", true);
+    CHECK(waitUntil([&]() { return handler.total() >= 20; }, 5000ms));
+    CHECK(handler.largest() == script.updateBytes);
+    CHECK(handler.intact());
+}
+
+static void slowReads() {
+    MockExchangeScript script;
+    script.readStall = 20ms;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    // Subscribe frames pile up in the client while the server is not reading
+    std::vector<std::string> streams;
+    for (int i = 0; i < 30; ++i) {
+        streams.push_back("sym" + std::to_string(i) + "@trade");
+        client->subscribeDynamic(streams.back(), "", true);
+    }
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 5000ms));
+    CHECK(client->reconnectStats().reconnects == 0);
+    std::printf("  30 acks behind a slow reader, max ack latency %.1f ms\n",
+                ms(client->subscribeStats().maxAckLatency));
+}
+
+static void ackLatencyUnderLoad() {
+    MockExchangeScript script;
+    script.updateInterval = 1ms;
+    script.updateBytes = 1024;
+    MockExchange exchange(script);
+    TestHandler handler;
+    auto client = connectTo(exchange, handler);
+
+    // 50 streams at 1 kHz each: 50k updates/s flowing at the client
+    std::vector<std::string> streams;
+    for (int i = 0; i < 50; ++i) {
+        streams.push_back("load" + std::to_string(i) + "@depth");
+    }
+    client->subscribeMany(streams, "", true);
+    CHECK(waitUntil([&]() { return allSubscribed(*client, streams); }, 2000ms));
+    CHECK(waitUntil([&]() { return handler.total() > 20000; }, 5000ms));
+
+    std::chrono::nanoseconds worst{0};
+    for (int i = 0; i < 10; ++i) {
+        const std::string stream = "extra" + std::to_string(i) + "@trade";
+        client->subscribeDynamic(stream, "", true);
+        CHECK(waitUntil([&]() { return client->isSubscribeOk(stream); }, 2000ms));
+        worst = std::max(worst, client->subscribeStats().lastAckLatency);
+    }
+    std::printf("  worst ack latency under load %.2f ms\n", ms(worst));
+    CHECK(worst < 100ms);
+}
+
+static void happyEyeballs() {
+    MockExchange exchange;
+    TestHandler handler;
+
+    // The host's first address never answers (TEST-NET-1) and the second
+    // refuses, only the last one reaches the exchange
+    DnsCacheConfig dnsConfig;
+    dnsConfig.probe = false;
+    dnsConfig.resolver = [](const std::string&, uint16_t, std::vector<std::string>& out) {
+        out = {"192.0.2.1", "127.0.0.2", "127.0.0.1"};
+        return true;
+    };
+    WsClientConfig config;
+    config.dnsCache = std::make_shared<DnsCache>(dnsConfig);
+    config.connectAttemptDelay = 100ms;
+    config.reconnectBaseDelay = 100ms;
+    auto client = std::make_shared<WsClient>(&handler, "edge.test", "/", exchange.port(), false, config);
+    CHECK(waitUntil([&]() { return client->connectionState() == ConnectionState::Connected; }, 3000ms));
+
+    auto stats = client->endpointStats();
+    CHECK(stats.size() == 3);
+    CHECK(!stats.empty() && stats[0].address == "127.0.0.1" && stats[0].connects == 1);
+    CHECK(stats.size() == 3 && stats[2].address == "127.0.0.2" && stats[2].failures >= 1);
+    std::printf("  handshake via %s in %.2f ms\n", stats[0].address.c_str(), ms(stats[0].handshakeRtt));
+
+    // The measured address goes first on reconnect, no attempt delay
+    exchange.closeAll();
+    CHECK(waitUntil([&]() { return client->reconnectStats().reconnects == 1; }, 3000ms));
+    std::printf("  reconnected after %.1f ms\n", ms(client->reconnectStats().lastOutage));
+    CHECK(client->reconnectStats().lastOutage < 250ms);
+    stats = client->endpointStats();
+    CHECK(!stats.empty() && stats[0].connects == 2);
+    CHECK(exchange.stats().connections == 2);
+}
+
+static const testing::TestCase tests[] = {
+    {"subscribe_ack", subscribeAck},
+    {"rate_burst_one", rateBurstOne},
+    {"ack_delay", ackDelay},
+    {"missing_ack_retry", missingAckRetry},
+    {"error_ack", errorAck},
+    {"reconnect_resubscribe", reconnectResubscribe},
+    {"reconnect_pending_unsubscribe", reconnectPendingUnsubscribe},
+    {"repeated_server_close", repeatedServerClose},
+    {"fragmented_frames", fragmentedFrames},
+    {"slow_reads", slowReads},
+    {"ack_latency_under_load", ackLatencyUnderLoad},
+    {"happy_eyeballs", happyEyeballs},
+};
+
+int main(int argc, char** argv) {
+    return testing::runTests(argc, argv, tests);
+}
@@ -0,0 +1,152 @@
+// ws_log_test.cpp
+//
+// Asynchronous logger: levels, argument capture and the writer thread.
+// ws_log_test [name] runs one test (as CTest does), or all of them.
+#include <ws_log.h>
+#include <test_main.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cexpp::util::wss;
+
+// Lines written for the "websocket" category since the last call
+static std::ostringstream output;
+
+static std::vector<std::string> written() {
+    flushLogs();
+    std::vector<std::string> lines;
+    std::istringstream in(output.str());
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+    output.str("");
+    return lines;
+}
+
+static void levels() {
+    const WsLogger logger(LogCategory::Client);
+    CHECK(logLevel(LogCategory::Client) == LogLevel::Info);
+    CHECK(!logger.enabled(LogLevel::Debug) && logger.enabled(LogLevel::Info));
+
+    logger.debug("hidden {}", 1);
+    logger.info("shown {}", 2);
+    setLogLevel(LogCategory::Client, LogLevel::Debug);
+    logger.debug("shown {}", 3);
+    setLogLevel(LogCategory::Client, LogLevel::Off);
+    logger.error("hidden {}", 4);
+    setLogLevel(LogCategory::Client, LogLevel::Info);
+
+    // Categories are independent
+    setLogLevel(LogCategory::Book, LogLevel::Error);
+    CHECK(logger.enabled(LogLevel::Info));
+    CHECK(!WsLogger(LogCategory::Book).enabled(LogLevel::Warn));
+    setLogLevel(LogCategory::Book, LogLevel::Info);
+    CHECK(std::strcmp(logCategoryName(LogCategory::Book), "websocket-book") == 0);
+
+    const auto lines = written();
+    CHECK(lines.size() == 2);
+    CHECK(lines.size() == 2 && lines[0] == "shown 2" && lines[1] == "shown 3");
+}
+
+static void arguments() {
+    const WsLogger logger(LogCategory::Client);
+    std::string owned = "owned";
+    char mutableText[] = "mutable";
+    logger.info("{} {} {} {} {} {}", owned, std::string_view("view"), "literal", mutableText, -7, 2.5);
+    logger.info("{} {} {}", true, static_cast<uint64_t>(1) << 63, 'x');
+    logger.warn("no arguments");
+
+    // The record outlives the caller's string
+    {
+        std::string temporary(20, 't');
+        logger.info("{}", temporary);
+        temporary.assign(20, 'u');
+    }
+
+    // Strings are cut short, later numbers are kept
+    const std::string big(1000, 'b');
+    logger.info("{}|{}", big, 42);
+
+    const auto lines = written();
+    CHECK(lines.size() == 5);
+    if (lines.size() == 5) {
+        CHECK(lines[0] == "owned view literal mutable -7 2.5");
+        CHECK(lines[1] == "true 9223372036854775808 x");
+        CHECK(lines[2] == "no arguments");
+        CHECK(lines[3] == std::string(20, 't'));
+        const size_t bar = lines[4].find('|');
+        CHECK(bar != std::string::npos && bar > 100 && bar < detail::LogRecord::argCapacity);
+        CHECK(lines[4].substr(0, bar) == std::string(bar, 'b'));
+        CHECK(lines[4].substr(bar) == "|42");
+    }
+}
+
+static void badFormat() {
+    const WsLogger logger(LogCategory::Client);
+    logger.info("{} {}", 1);
+    logger.info("after");
+    const auto lines = written();
+    CHECK(lines.size() == 2);
+    CHECK(lines.size() == 2 && lines[0].find("bad log format") != std::string::npos && lines[1] == "after");
+}
+
+static void producers() {
+    // Several threads at once: every record is either written whole or counted as dropped
+    const WsLogger logger(LogCategory::Client);
+    const uint64_t droppedBefore = droppedLogRecords();
+    constexpr int threads = 4;
+    constexpr int perThread = 20000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&logger, t] {
+            for (int i = 0; i < perThread; ++i) {
+                logger.info("t{} {}", t, i);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const auto lines = written();
+    const uint64_t dropped = droppedLogRecords() - droppedBefore;
+
+    size_t records = 0;
+    std::vector<int> last(threads, -1);
+    bool ordered = true;
+    for (const auto& line : lines) {
+        int t = 0;
+        int i = 0;
+        if (std::sscanf(line.c_str(), "t%d %d", &t, &i) != 2) {
+            continue; // the drop report
+        }
+        ++records;
+        ordered = ordered && t >= 0 && t < threads && i > last[t];
+        last[t] = i;
+    }
+    CHECK(records + dropped == threads * perThread);
+    CHECK(ordered);
+}
+
+static const testing::TestCase tests[] = {
+    {"levels", levels},
+    {"arguments", arguments},
+    {"bad_format", badFormat},
+    {"producers", producers},
+};
+
+int main(int argc, char** argv) {
+    // Registered before the first record, so the writer picks it up
+    auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(output);
+    auto logger = std::make_shared<spdlog::logger>(logCategoryName(LogCategory::Client), sink);
+    logger->set_pattern("%v");
+    logger->set_level(spdlog::level::trace);
+    spdlog::register_logger(logger);
+
+    return testing::runTests(argc, argv, tests);
+}